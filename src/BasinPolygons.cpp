@@ -0,0 +1,119 @@
+#include "BasinPolygons.hpp"
+
+namespace processedfolder {
+	//stripes thinner than this cost more in boundary basins than they save
+	static constexpr lapis::rowcol_t minStripeRows = 64;
+
+	lapis::VectorDataset<lapis::MultiPolygon> vectorizeBasins(const lapis::Raster<int>& basin, int nThread)
+	{
+		lapis::rowcol_t nStripe = std::min<lapis::rowcol_t>(nThread, basin.nrow() / minStripeRows);
+		if (nStripe <= 1) {
+			return lapis::rasterToMultiPolygonForTaos(basin);
+		}
+		lapis::rowcol_t rowsPerStripe = (basin.nrow() + nStripe - 1) / nStripe;
+		nStripe = (basin.nrow() + rowsPerStripe - 1) / rowsPerStripe;
+
+		//the rows are inset by a quarter cell so the crop snaps to exactly the stripe's rows
+		auto stripeRaster = [&](lapis::rowcol_t stripe) {
+			lapis::rowcol_t firstRow = stripe * rowsPerStripe;
+			lapis::rowcol_t endRow = std::min(firstRow + rowsPerStripe, basin.nrow());
+			lapis::coord_t ymax = basin.ymax() - firstRow * basin.yres() - basin.yres() / 4;
+			lapis::coord_t ymin = basin.ymax() - endRow * basin.yres() + basin.yres() / 4;
+			lapis::Alignment a = cropAlignment(basin, lapis::Extent(basin.xmin(), basin.xmax(), ymin, ymax), lapis::SnapType::out);
+			lapis::Raster<int> out{ a };
+			for (lapis::cell_t c = 0; c < out.ncell(); ++c) {
+				lapis::cell_t from = basin.cellFromXYUnsafe(out.xFromCell(c), out.yFromCell(c));
+				if (basin.atCellUnsafe(from).has_value()) {
+					out[c].has_value() = true;
+					out[c].value() = basin.atCellUnsafe(from).value();
+				}
+			}
+			return out;
+			};
+
+		//a basin is traced with its stripe only if none of it is in another stripe
+		//the first cell of each basin is kept too, in the order the raster is scanned, to put the features back in order
+		std::vector<std::unordered_map<int, lapis::cell_t>> firstCellByStripe(nStripe);
+		std::function<int(size_t)> collect = [&](size_t stripe) {
+			lapis::rowcol_t firstRow = (lapis::rowcol_t)stripe * rowsPerStripe;
+			lapis::rowcol_t endRow = std::min(firstRow + rowsPerStripe, basin.nrow());
+			for (lapis::cell_t c = basin.cellFromRowColUnsafe(firstRow, 0); c < (lapis::cell_t)endRow * basin.ncol(); ++c) {
+				if (basin.atCellUnsafe(c).has_value()) {
+					firstCellByStripe[stripe].try_emplace(basin.atCellUnsafe(c).value(), c);
+				}
+			}
+			return 0;
+			};
+		std::function<void(size_t, int&)> ignore = [](size_t, int&) {};
+		orderedParallelFor(nStripe, collect, ignore, nThread);
+
+		std::unordered_map<int, int> nStripeById;
+		std::unordered_map<int, lapis::cell_t> firstCell;
+		for (const auto& ids : firstCellByStripe) {
+			for (const auto& [id, cell] : ids) {
+				++nStripeById[id];
+				//stripes are in row order, so the first stripe a basin appears in has its first cell
+				firstCell.try_emplace(id, cell);
+			}
+		}
+		if (nStripeById.empty()) {
+			return lapis::rasterToMultiPolygonForTaos(basin);
+		}
+		std::unordered_set<int> crossing;
+		for (const auto& [id, n] : nStripeById) {
+			if (n > 1) {
+				crossing.insert(id);
+			}
+		}
+
+		//stripes 0 to nStripe-1 trace their own basins, and the last job traces the crossing ones from the full raster
+		std::function<lapis::VectorDataset<lapis::MultiPolygon>(size_t)> trace = [&](size_t job) {
+			if ((lapis::rowcol_t)job < nStripe) {
+				lapis::Raster<int> stripe = stripeRaster((lapis::rowcol_t)job);
+				for (lapis::cell_t c = 0; c < stripe.ncell(); ++c) {
+					if (stripe[c].has_value() && crossing.count(stripe[c].value())) {
+						stripe[c].has_value() = false;
+					}
+				}
+				return lapis::rasterToMultiPolygonForTaos(stripe);
+			}
+			lapis::Raster<int> rest = basin;
+			for (lapis::cell_t c = 0; c < rest.ncell(); ++c) {
+				if (rest[c].has_value() && !crossing.count(rest[c].value())) {
+					rest[c].has_value() = false;
+				}
+			}
+			return lapis::rasterToMultiPolygonForTaos(rest);
+			};
+		std::vector<lapis::VectorDataset<lapis::MultiPolygon>> pieces;
+		std::function<void(size_t, lapis::VectorDataset<lapis::MultiPolygon>&)> keep = [&](size_t, lapis::VectorDataset<lapis::MultiPolygon>& piece) {
+			pieces.push_back(std::move(piece));
+			};
+		orderedParallelFor((size_t)nStripe + (crossing.size() ? 1 : 0), trace, keep, nThread);
+
+		//every basin is in exactly one piece, and they're put in the order a scan of the whole raster first meets them
+		struct Placed {
+			lapis::cell_t firstCell;
+			size_t piece;
+			size_t feature;
+		};
+		std::vector<Placed> placed;
+		std::optional<size_t> templatePiece;
+		for (size_t p = 0; p < pieces.size(); ++p) {
+			for (size_t f = 0; f < pieces[p].nFeature(); ++f) {
+				placed.push_back({ firstCell.at(pieces[p].getFeature(f).getNumericField<int>("ID")), p, f });
+			}
+			if (!templatePiece && pieces[p].nFeature()) {
+				templatePiece = p;
+			}
+		}
+		std::sort(placed.begin(), placed.end(), [](const Placed& a, const Placed& b) { return a.firstCell < b.firstCell; });
+
+		//a piece with no basins may not have the fields, so the schema comes from one that does
+		lapis::VectorDataset<lapis::MultiPolygon> out = lapis::emptyVectorDatasetFromTemplate(pieces[templatePiece.value_or(0)]);
+		for (const Placed& pl : placed) {
+			out.addFeature(pieces[pl.piece].getFeature(pl.feature));
+		}
+		return out;
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+#ifndef BASINPOLYGONS_H
+#define BASINPOLYGONS_H
+
+#include "ProcessedFolder_pch.hpp"
+#include "Parallel.hpp"
+
+namespace processedfolder {
+	//The same polygons as lapis::rasterToMultiPolygonForTaos(basin), one per basin ID, traced on several threads
+	//The raster is cut into stripes of rows that are traced separately; basins that appear in more than one stripe are traced together afterwards,
+	//so every basin is traced whole, exactly as it would be from the full raster
+	//Features are ordered by the first cell of each basin in row-major order, whatever order the pieces came back in
+	//With nThread <= 1, or a raster too small to split, this is just rasterToMultiPolygonForTaos(basin)
+	lapis::VectorDataset<lapis::MultiPolygon> vectorizeBasins(const lapis::Raster<int>& basin, int nThread = availableThreads());
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "FileManifest.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	FileManifest::FileManifest(const std::vector<fs::path>& roots) : _roots(roots)
+	{
+		for (const fs::path& root : _roots) {
+			_rootKeys.insert(_key(root));
+		}
+	}
+
+	bool FileManifest::exists(const fs::path& p) const
+	{
+		_buildIfNeeded();
+		std::shared_lock lock{ _mut };
+		//the roots are listed recursively, so anything beneath one is known, including directories that don't exist
+		fs::path parent = p.lexically_normal().parent_path();
+		while (!parent.empty()) {
+			if (_rootKeys.contains(_key(parent))) {
+				return _entries.contains(_key(p));
+			}
+			if (parent == parent.parent_path()) {
+				break;
+			}
+			parent = parent.parent_path();
+		}
+		return fs::exists(p);
+	}
+
+	std::vector<fs::path> FileManifest::filesIn(const fs::path& dir) const
+	{
+		_buildIfNeeded();
+		std::shared_lock lock{ _mut };
+		auto it = _listedDirs.find(_key(dir));
+		if (it != _listedDirs.end()) {
+			return it->second;
+		}
+		lock.unlock();
+
+		std::vector<fs::path> out;
+		if (!fs::is_directory(dir)) {
+			return out;
+		}
+		for (const auto& entry : fs::directory_iterator(dir)) {
+			out.push_back(entry.path());
+		}
+		std::sort(out.begin(), out.end());
+		return out;
+	}
+
+	void FileManifest::refresh()
+	{
+		std::unique_lock lock{ _mut };
+		_built = false;
+		_entries.clear();
+		_listedDirs.clear();
+	}
+
+	void FileManifest::_buildIfNeeded() const
+	{
+		{
+			std::shared_lock lock{ _mut };
+			if (_built) {
+				return;
+			}
+		}
+		std::unique_lock lock{ _mut };
+		if (_built) {
+			return;
+		}
+
+		//directory_entry caches the file type from the listing itself, so this doesn't stat every file
+		std::queue<fs::path> toList;
+		for (const fs::path& root : _roots) {
+			toList.push(root);
+		}
+		while (toList.size()) {
+			fs::path dir = toList.front();
+			toList.pop();
+
+			std::error_code ec;
+			fs::directory_iterator it{ dir, ec };
+			if (ec) {
+				continue;
+			}
+			std::vector<fs::path>& contents = _listedDirs[_key(dir)];
+			for (const fs::directory_entry& entry : it) {
+				_entries.insert(_key(entry.path()));
+				contents.push_back(entry.path());
+				if (entry.is_directory(ec)) {
+					toList.push(entry.path());
+				}
+			}
+			std::sort(contents.begin(), contents.end());
+		}
+		_built = true;
+	}
+
+	std::string FileManifest::_key(const fs::path& p)
+	{
+		std::string out = p.lexically_normal().generic_string();
+#ifdef _WIN32
+		//matching fs::exists on a case-insensitive filesystem
+		std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+#endif
+		return out;
+	}
+}
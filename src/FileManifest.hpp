@@ -0,0 +1,37 @@
+#pragma once
+#ifndef FILEMANIFEST_H
+#define FILEMANIFEST_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//A listing of every file under a set of root directories, taken once and then used in place of fs::exists
+	//The listing is taken the first time it's needed, and can be retaken with refresh() if the run is still being written
+	//Paths that aren't inside a listed directory fall back to asking the filesystem
+	class FileManifest {
+	public:
+		FileManifest() = default;
+		FileManifest(const std::vector<std::filesystem::path>& roots);
+
+		bool exists(const std::filesystem::path& p) const;
+
+		//all files directly inside the given directory, in sorted order
+		std::vector<std::filesystem::path> filesIn(const std::filesystem::path& dir) const;
+
+		void refresh();
+
+	private:
+		std::vector<std::filesystem::path> _roots;
+		std::unordered_set<std::string> _rootKeys;
+
+		mutable std::shared_mutex _mut;
+		mutable bool _built = false;
+		mutable std::unordered_set<std::string> _entries;
+		mutable std::unordered_map<std::string, std::vector<std::filesystem::path>> _listedDirs;
+
+		void _buildIfNeeded() const;
+		static std::string _key(const std::filesystem::path& p);
+	};
+}
+
+#endif
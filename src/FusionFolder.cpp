@@ -1,13 +1,13 @@
 #include "FusionFolder.hpp"
+#include "TileMosaic.hpp"
+#include "Parallel.hpp"
+#include "OgrFilter.hpp"
 
 namespace processedfolder {
 	namespace fs = std::filesystem;
 
-	FusionFolder::FusionFolder(const fs::path& folder)
-	{
-		if (!fs::is_directory(folder)) {
-			throw std::invalid_argument("Folder does not exist");
-		}
+	//FUSION runs can be nested inside Products* and FINAL* folders, so this searches those for the folder containing Layout_shapefiles
+	static std::optional<fs::path> findFusionRoot(const fs::path& folder) {
 		const auto layoutregex = std::regex{ "Layout_shapefiles" };
 		const auto productsregex = std::regex{ "Products.*" };
 		const auto finalregex = std::regex{ "FINAL.*" };
@@ -16,31 +16,83 @@ namespace processedfolder {
 		candidates.push(folder);
 
 		while (candidates.size()) {
-			const fs::path& candidate = candidates.front();
+			const fs::path candidate = candidates.front();
+			candidates.pop();
 
 			for (fs::path subdir : fs::directory_iterator(candidate)) {
 				if (std::regex_match(subdir.stem().string(), layoutregex)) {
-					_folder = candidate;
-					const auto ptilesregex = std::regex{ R"(.*_ProcessingTiles\.shp)" };
-					for (fs::path file : fs::directory_iterator(_folder / "Layout_shapefiles")) {
-						if (std::regex_match(file.filename().string(), ptilesregex)) {
-							_layoutPath = file;
-							_layout = lapis::VectorDataset<lapis::Polygon>(_layoutPath.string());
-							break;
-						}
-					}
-					_proj = lapis::Raster<int>(maskRaster().value().string()).crs();
-					_layout.projectInPlace(_proj);
-					return;
+					return candidate;
 				}
 				if (std::regex_match(subdir.stem().string(), productsregex) ||
 					std::regex_match(subdir.stem().string(), finalregex)) {
 					candidates.push(subdir);
 				}
 			}
-			candidates.pop();
 		}
-		throw std::invalid_argument("Not a fusion folder");
+		return std::nullopt;
+	}
+
+	//FUSION's column names vary between versions, so they're found by pattern
+	static std::optional<TaoFieldNames> fusionTaoFields(const std::vector<std::string>& fieldNames) {
+		static const std::regex xr{ ".*HighX.*" };
+		static const std::regex yr{ ".*HighY.*" };
+		static const std::regex ar{ ".*Area.*" };
+		static const std::regex hr{ ".*MaxHt.*" };
+		static const std::regex idr{ ".*BasinID.*" };
+
+		TaoFieldNames out;
+		for (const std::string& name : fieldNames) {
+			if (std::regex_match(name, xr)) {
+				out.x = name;
+			}
+			else if (std::regex_match(name, yr)) {
+				out.y = name;
+			}
+			else if (std::regex_match(name, ar)) {
+				out.area = name;
+			}
+			else if (std::regex_match(name, hr)) {
+				out.height = name;
+			}
+			else if (std::regex_match(name, idr)) {
+				out.id = name;
+			}
+		}
+		if (out.x == "" || out.y == "" || out.area == "" || out.height == "") {
+			return std::nullopt;
+		}
+		return out;
+	}
+
+	FusionFolder::FusionFolder(const fs::path& folder)
+	{
+		if (!fs::is_directory(folder)) {
+			throw std::invalid_argument("Folder does not exist");
+		}
+		std::optional<fs::path> root = findFusionRoot(folder);
+		if (!root) {
+			throw std::invalid_argument("Not a fusion folder");
+		}
+		_folder = root.value();
+
+		const auto ptilesregex = std::regex{ R"(.*_ProcessingTiles\.shp)" };
+		for (fs::path file : fs::directory_iterator(_folder / "Layout_shapefiles")) {
+			if (std::regex_match(file.filename().string(), ptilesregex)) {
+				_layoutPath = file;
+				_layout = lapis::VectorDataset<lapis::Polygon>(_layoutPath.string());
+				break;
+			}
+		}
+		//only the header is needed for the projection, so this avoids reading the mask's pixels
+		_proj = lapis::Alignment(maskRaster().value().string()).crs();
+		_layout.projectInPlace(_proj);
+
+		std::vector<lapis::Extent> tileExtents;
+		for (size_t i = 0; i < _layout.nFeature(); ++i) {
+			tileExtents.push_back(_layout.getFeature(i).getGeometry().boundingBox());
+		}
+		_tileIndex = TileIndex(tileExtents);
+		_buildTopoTables();
 	}
 
 	const fs::path FusionFolder::dir() const
@@ -209,16 +261,44 @@ namespace processedfolder {
 		if (index < 0 || index >= nTiles()) {
 			return std::optional<lapis::Extent>();
 		}
-		return _layout.getFeature(index).getGeometry().boundingBox();
+		return _tileIndex.tileExtent(index);
 	}
 
-	lapis::VectorDataset<lapis::Point> FusionFolder::allHighPoints() const
+	//Reads every tile's file through the filter filterFor gives for it, and appends the results in tile order
+	//The files are read and filtered on worker threads; only the copy into the output happens on the calling thread
+	template<class T>
+	static lapis::VectorDataset<T> allFiltered(size_t nTile, const std::function<std::optional<fs::path>(size_t)>& byTile,
+		const std::function<OgrFilter(size_t, const fs::path&)>& filterFor) {
+		std::vector<std::optional<fs::path>> files(nTile);
+		for (size_t i = 0; i < nTile; ++i) {
+			files[i] = byTile(i);
+		}
+
+		std::function<std::optional<lapis::VectorDataset<T>>(size_t)> read = [&](size_t i)->std::optional<lapis::VectorDataset<T>> {
+			if (!files[i]) {
+				return std::nullopt;
+			}
+			return readFiltered<T>(files[i].value(), filterFor(i, files[i].value()));
+			};
+
+		lapis::VectorDataset<T> out{};
+		bool outInit = false;
+		std::function<void(size_t, std::optional<lapis::VectorDataset<T>>&)> add = [&](size_t, std::optional<lapis::VectorDataset<T>>& tile) {
+			if (tile) {
+				mergeInto(out, outInit, tile.value());
+			}
+			};
+		orderedParallelFor(nTile, read, add);
+		return out;
+	}
+
+	lapis::VectorDataset<lapis::Point> FusionFolder::allHighPoints(GeometryMode mode) const
 	{
-		std::cout << "WARNING: Loading highpoints with this function needs to be optimized (fusionfolder)\n";
-		return highPoints(_layout.extent());
+		return allFiltered<lapis::Point>(nTiles(), [&](size_t i) { return highPoints(i); },
+			[&](size_t i, const fs::path& file) { return _ownedFilter(i, file, std::nullopt, mode); });
 	}
 
-	lapis::VectorDataset<lapis::Point> FusionFolder::highPoints(const lapis::Extent& e) const {
+	lapis::VectorDataset<lapis::Point> FusionFolder::highPoints(const lapis::Extent& e, GeometryMode mode) const {
 		lapis::VectorDataset<lapis::Point> out{};
 		bool outInit = false;
 
@@ -227,26 +307,10 @@ namespace processedfolder {
 			return out;
 		}
 
-		for (size_t i = 0; i < _layout.nFeature(); ++i) {
+		for (size_t i : _tileIndex.overlapping(projE)) {
 			std::optional<fs::path> filePath = highPoints(i);
 			if (filePath) {
-				auto tileExtent = extentByTile(i).value();
-				if (!projE.overlaps(tileExtent)) {
-					continue;
-				}
-				lapis::VectorDataset<lapis::Point> thisPoints{ filePath.value() };
-				if (thisPoints.nFeature()) {
-					if (!outInit) {
-						out = lapis::emptyVectorDatasetFromTemplate(thisPoints);
-					}
-					for (lapis::ConstFeature<lapis::Point> ft : thisPoints) {
-						if (projE.contains(ft.getGeometry().x(), ft.getGeometry().y())) {
-							if (tileExtent.contains(ft.getGeometry().x(), ft.getGeometry().y())) {
-								out.addFeature(ft);
-							}
-						}
-					}
-				}
+				appendFiltered(out, outInit, filePath.value(), _ownedFilter(i, filePath.value(), projE, mode));
 			}
 		}
 		return out;
@@ -265,65 +329,50 @@ namespace processedfolder {
 		return std::optional<fs::path>();
 	}
 
-	lapis::VectorDataset<lapis::MultiPolygon> FusionFolder::allPolygons() const {
-		std::cout << "WARNING: Loading polygons with this function needs to be optimized (fusionfolder)\n";
-		return polygons(_layout.extent());
+	lapis::VectorDataset<lapis::MultiPolygon> FusionFolder::allPolygons(GeometryMode mode) const {
+		return allFiltered<lapis::MultiPolygon>(nTiles(), [&](size_t i) { return polygons(i); },
+			[&](size_t i, const fs::path& file) { return _ownedFilter(i, file, std::nullopt, mode); });
 	}
 	
-	lapis::VectorDataset<lapis::MultiPolygon> FusionFolder::polygons(const lapis::Extent& e) const {
+	lapis::VectorDataset<lapis::MultiPolygon> FusionFolder::polygons(const lapis::Extent& e, GeometryMode mode) const {
 		lapis::VectorDataset<lapis::MultiPolygon> out;
-		std::regex xr{ ".*HighX.*" };
-		std::regex yr{ ".*HighY.*" };
-		std::regex ar{ ".*Area.*" };
-		std::regex hr{ ".*MaxHt.*" };
+		bool outInit = false;
 
 		lapis::Extent projE = lapis::QuadExtent(e, _layout.crs()).outerExtent();
 		if (!projE.overlaps(_layout.extent())) {
 			return out;
 		}
 
-		for (size_t i = 0; i < nTiles(); ++i) {
+		for (size_t i : _tileIndex.overlapping(projE)) {
 			auto polygonFile = polygons(i);
 			if (polygonFile) {
-				auto tileExtent = extentByTile(i).value();
-				if (!projE.overlaps(tileExtent)) {
-					continue;
-				}
-				lapis::VectorDataset<lapis::MultiPolygon> thisPolygons{ polygonFile.value() };
-				if (_x == "") {
-					for (auto name : thisPolygons.getAllFieldNames()) {
-						if (std::regex_match(name, xr)) {
-							_x = name;
-						}
-						else if (std::regex_match(name, yr)) {
-							_y = name;
-						}
-						else if (std::regex_match(name, ar)) {
-							_a = name;
-						}
-						else if (std::regex_match(name, hr)) {
-							_h = name;
-						}
-					}
-					if (_x == "" || _y == "" || _a == "" || _h == "") {
-						std::cerr << "Found polygon files but could not deduce one of x,y,area, or height from the column names.\n";
-						std::cerr << polygonFile.value().string() << "\n";
-						throw FileNotFoundException("Found polygon files but could not deduce one of x,y,area, or height from the column names.");
-					}
-					out = lapis::emptyVectorDatasetFromTemplate(thisPolygons);
-				}
-				for (lapis::ConstFeature<lapis::MultiPolygon> ft : thisPolygons) {
-					auto x = ft.getNumericField<lapis::coord_t>(_x);
-					auto y = ft.getNumericField<lapis::coord_t>(_y);
-					if (tileExtent.contains(x, y) && projE.contains(x, y)) {
-						out.addFeature(ft);
-					}
-				}
+				appendFiltered(out, outInit, polygonFile.value(), _ownedFilter(i, polygonFile.value(), projE, mode));
 			}
 		}
 		return out;
 	}
 	
+	//Fusion tiles are buffered, so unlike the other run types each tile's file is filtered down to the features inside the tile proper
+	TileCursor<lapis::Point> FusionFolder::highPointCursor(bool readAhead, GeometryMode mode) const {
+		return TileCursor<lapis::Point>(nTiles(), [this, mode](size_t i)->std::optional<lapis::VectorDataset<lapis::Point>> {
+			std::optional<fs::path> file = highPoints(i);
+			if (!file) {
+				return std::nullopt;
+			}
+			return readFiltered<lapis::Point>(file.value(), _ownedFilter(i, file.value(), std::nullopt, mode));
+			}, readAhead);
+	}
+
+	TileCursor<lapis::MultiPolygon> FusionFolder::polygonCursor(bool readAhead, GeometryMode mode) const {
+		return TileCursor<lapis::MultiPolygon>(nTiles(), [this, mode](size_t i)->std::optional<lapis::VectorDataset<lapis::MultiPolygon>> {
+			std::optional<fs::path> file = polygons(i);
+			if (!file) {
+				return std::nullopt;
+			}
+			return readFiltered<lapis::MultiPolygon>(file.value(), _ownedFilter(i, file.value(), std::nullopt, mode));
+			}, readAhead);
+	}
+
 	std::optional<fs::path> FusionFolder::polygons(size_t index) const {
 		auto identifier = this->_layout.getStringField(index, "Identifier");
 		fs::path candidate = _folder / "Segments_2p4606FEET" / (identifier + "_segments_Polygons.shp");
@@ -338,37 +387,21 @@ namespace processedfolder {
 		return std::optional<fs::path>();
 	}
 
+	//tiles are buffered, so each tile only contributes the cells inside its own extent
 	template<class T>
-	std::optional<lapis::Raster<T>> fineDataByExtentGeneric(const lapis::Extent& e, const lapis::VectorDataset<lapis::Polygon>& tileLayout, std::function<std::optional<fs::path>(size_t)> byTile) {
-		std::optional<lapis::Raster<T>> out{};
+	static void overlayTile(lapis::Raster<T>& out, const lapis::Raster<T>& tile) {
+		out.overlayInside(tile);
+	}
 
+	template<class T>
+	std::optional<lapis::Raster<T>> fineDataByExtentGeneric(const lapis::Extent& e, const lapis::VectorDataset<lapis::Polygon>& tileLayout, const TileIndex& tileIndex,
+		std::function<std::optional<fs::path>(size_t)> byTile, TileCache* cache, const std::string& product, const TileReader<T>& reader = nullptr) {
 		lapis::Extent projE = lapis::QuadExtent(e, tileLayout.crs()).outerExtent();
 		if (!projE.overlaps(tileLayout.extent())) {
 			return std::optional<lapis::Raster<T>>{};
 		}
 
-		for (size_t i = 0; i < tileLayout.nFeature(); ++i) {
-			std::optional<fs::path> filePath = byTile(i);
-			if (!filePath) {
-				continue;
-			}
-			try {
-				if (!out.has_value()) {
-					lapis::Alignment a{ filePath.value().string() };
-					a.defineCRS(tileLayout.crs());
-					a = extendAlignment(a, projE, lapis::SnapType::out);
-					a = cropAlignment(a, projE, lapis::SnapType::out);
-					out = lapis::Raster<T>{ a };
-				}
-				lapis::Raster<T> tile{ filePath.value().string(), projE, lapis::SnapType::out };
-				tile.defineCRS(tileLayout.crs());
-				out->overlayInside(tile);
-			}
-			catch (lapis::LapisGisException e) {
-				continue;
-			}
-		}
-		return out;
+		return mosaicTiles<T>(projE, tileLayout.crs(), tileIndex.overlapping(projE), byTile, overlayTile<T>, cache, product, reader);
 	}
 
 	std::optional<fs::path> FusionFolder::watershedSegmentRaster(size_t index) const
@@ -378,7 +411,7 @@ namespace processedfolder {
 
 	std::optional<lapis::Raster<lapis::taoid_t>> FusionFolder::watershedSegmentRaster(const lapis::Extent& e) const
 	{
-		return fineDataByExtentGeneric<lapis::taoid_t>(e, _layout, [&](size_t n) { return watershedSegmentRaster(n); });
+		return fineDataByExtentGeneric<lapis::taoid_t>(e, _layout, _tileIndex, [&](size_t n) { return watershedSegmentRaster(n); }, _tileCache.get(), "segments");
 	}
 
 	std::optional<fs::path> FusionFolder::intensityRaster(size_t index) const
@@ -388,7 +421,7 @@ namespace processedfolder {
 
 	std::optional<lapis::Raster<lapis::intensity_t>> FusionFolder::intensityRaster(const lapis::Extent& e) const
 	{
-		return fineDataByExtentGeneric<lapis::intensity_t>(e, _layout, [&](size_t n) { return intensityRaster(n); });
+		return fineDataByExtentGeneric<lapis::intensity_t>(e, _layout, _tileIndex, [&](size_t n) { return intensityRaster(n); }, _tileCache.get(), "intensity");
 	}
 
 	std::optional<fs::path> FusionFolder::maxHeightRaster(size_t index) const
@@ -398,7 +431,7 @@ namespace processedfolder {
 
 	std::optional<lapis::Raster<lapis::csm_t>> FusionFolder::maxHeightRaster(const lapis::Extent& e) const
 	{
-		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, [&](size_t n) { return maxHeightRaster(n); });
+		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, _tileIndex, [&](size_t n) { return maxHeightRaster(n); }, _tileCache.get(), "maxHeight");
 	}
 
 	std::optional<fs::path> FusionFolder::csmRaster(size_t index) const
@@ -425,7 +458,82 @@ namespace processedfolder {
 
 	std::optional<lapis::Raster<lapis::csm_t>> FusionFolder::csmRaster(const lapis::Extent& e) const
 	{
-		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, [&](size_t n) { return csmRaster(n); });
+		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, _tileIndex, [&](size_t n) { return csmRaster(n); }, _tileCache.get(), "csm");
+	}
+
+	std::optional<lapis::Raster<float>> FusionFolder::_reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<float>& reader, const std::string& cacheName) const
+	{
+		return fineDataByExtentGeneric<float>(e, _layout, _tileIndex, [&](size_t n) { return tileFile(product, n); }, _tileCache.get(), cacheName, reader);
+	}
+
+	std::optional<lapis::Raster<ScaledHeight>> FusionFolder::_reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<ScaledHeight>& reader, const std::string& cacheName) const
+	{
+		return fineDataByExtentGeneric<ScaledHeight>(e, _layout, _tileIndex, [&](size_t n) { return tileFile(product, n); }, _tileCache.get(), cacheName, reader);
+	}
+
+	std::optional<VirtualMosaic<lapis::csm_t>> FusionFolder::_heightMosaic(const lapis::Extent& e, TileProduct product, size_t maxBlocks) const
+	{
+		lapis::Extent projE = lapis::QuadExtent(e, _layout.crs()).outerExtent();
+		if (!projE.overlaps(_layout.extent())) {
+			return std::nullopt;
+		}
+		return openVirtualMosaic<lapis::csm_t>(projE, _layout.crs(), _tileIndex.overlapping(projE), [this](size_t n) { return extentByTile(n); },
+			[this, product](size_t n) { return tileFile(product, n); }, overlayTile<lapis::csm_t>, maxBlocks);
+	}
+
+	TaoFieldNames FusionFolder::_deduceFieldNames(const std::vector<std::string>& fieldNames, const fs::path& file) const
+	{
+		std::optional<TaoFieldNames> names = fusionTaoFields(fieldNames);
+		if (!names) {
+			std::cerr << "Found polygon files but could not deduce one of x,y,area, or height from the column names.\n";
+			std::cerr << file.string() << "\n";
+			throw FileNotFoundException("Found polygon files but could not deduce one of x,y,area, or height from the column names.");
+		}
+		//tiles can be read on several threads at once
+		static std::mutex mut;
+		std::lock_guard lock{ mut };
+		if (_x == "") {
+			_x = names->x;
+			_y = names->y;
+			_a = names->area;
+			_h = names->height;
+		}
+		return names.value();
+	}
+
+	OgrFilter FusionFolder::_ownedFilter(size_t index, const fs::path& file, const std::optional<lapis::Extent>& e, GeometryMode mode) const
+	{
+		OgrFilter filter;
+		filter.geometry = mode;
+		filter.where = [this, index, file, e](const std::vector<std::string>& fieldNames) {
+			TaoFieldNames names = _deduceFieldNames(fieldNames, file);
+			std::string where = insideWhere(names.x, names.y, _tileIndex.tileExtent(index));
+			if (e) {
+				where += " AND " + insideWhere(names.x, names.y, e.value());
+			}
+			return where;
+			};
+		return filter;
+	}
+
+	TaoFieldResolver FusionFolder::_taoFields() const
+	{
+		return fusionTaoFields;
+	}
+
+	TaoTable FusionFolder::_readTaoTable(size_t index, const fs::path& file) const
+	{
+		TaoTable out;
+		//tiles are buffered, so only the TAOs inside the tile proper belong to it
+		lapis::Extent tileExtent = extentByTile(index).value();
+		readTaoFile(file, fusionTaoFields, (uint32_t)index, out,
+			[&](lapis::coord_t x, lapis::coord_t y) { return tileExtent.contains(x, y); });
+		return out;
+	}
+
+	std::vector<size_t> FusionFolder::_tilesOverlapping(const lapis::Extent& projE) const
+	{
+		return _tileIndex.overlapping(projE);
 	}
 
 	std::function<lapis::CoordXY(const lapis::ConstFeature<lapis::Point>&)> FusionFolder::coordGetter() const {
@@ -475,36 +583,50 @@ namespace processedfolder {
 
 	std::optional<fs::path> FusionFolder::_getTopoMetric(const std::string& basename, lapis::coord_t radiusMeters) const
 	{
-		std::string folderBaseName = "TopoMetrics";
-		auto lookForFile = [&](const std::string& resName, lapis::coord_t convFactor)->std::optional<std::string> {
-			std::string folderName = folderBaseName + resName;
-			if (!fs::exists(_folder / folderName)) {
-				return std::optional<std::string>();
-			}
+		std::optional<fs::path> out = _topoTables.at(basename + "_30METERS")->nearest(radiusMeters, 1);
+		if (out.has_value()) {
+			return out;
+		}
+		return _topoTables.at(basename + "_98p424FEET")->nearest(radiusMeters / 0.3048, 1);
+	}
+
+	void FusionFolder::_buildTopoTables()
+	{
+		const std::regex scalepattern{ "[0-9]*(p?)[0-9]*(M|F)_" };
+		const std::regex decimal{ "p" };
+		for (const std::string basename : { "slope", "aspect", "tpi" }) {
 			std::regex pattern{ "^topo_" + basename + "_[0-9]*p?[0-9]*(M|F)_[0-9].*" };
-			for (fs::path subfile : fs::directory_iterator(_folder / folderName)) {
-				std::string filestr = subfile.filename().string();
-				if (std::regex_match(filestr, pattern)) {
-					std::regex  scalepattern{ "[0-9]*(p?)[0-9]*(M|F)_" };
-					std::smatch m;
-					std::regex_search(filestr, m, scalepattern);
-					std::string scalestring = m.str().substr(0, m.str().size() - 2);
-					scalestring = std::regex_replace(scalestring, std::regex{ "p" }, ".");
-					auto scalenum = std::stod(scalestring);
-					if (std::abs(scalenum - radiusMeters / convFactor) > 1) {
-						continue;
-					}
-					return (_folder / folderName / filestr).string();
+			auto parser = [=](const std::string& fileName)->std::optional<lapis::coord_t> {
+				if (!std::regex_match(fileName, pattern)) {
+					return std::nullopt;
+				}
+				std::smatch m;
+				if (!std::regex_search(fileName, m, scalepattern)) {
+					return std::nullopt;
 				}
+				std::string scalestring = m.str().substr(0, m.str().size() - 2);
+				scalestring = std::regex_replace(scalestring, decimal, ".");
+				try {
+					return std::stod(scalestring);
+				}
+				catch (std::logic_error e) {
+					return std::nullopt;
+				}
+				};
+			for (const std::string resName : { "_30METERS", "_98p424FEET" }) {
+				fs::path topoFolder = _folder / ("TopoMetrics" + resName);
+				auto lister = [topoFolder]() {
+					std::vector<fs::path> out;
+					if (fs::exists(topoFolder)) {
+						for (const fs::directory_entry& entry : fs::directory_iterator(topoFolder)) {
+							out.push_back(entry.path());
+						}
+					}
+					return out;
+					};
+				_topoTables[basename + resName] = std::make_shared<TopoScaleTable>(lister, parser);
 			}
-			return std::optional<std::string>();
-		};
-
-		std::optional<std::string> out = lookForFile("_30METERS", 1);
-		if (out.has_value()) {
-			return out;
 		}
-		return lookForFile("_98p424FEET", 0.3048);
 	}
 
 	std::optional<fs::path> FusionFolder::_getTileMetric(const std::string& basename, size_t index) const
@@ -532,4 +654,12 @@ namespace processedfolder {
 		}
 		return out;
 	}
+
+	bool isFusionFolder(const fs::path& path)
+	{
+		if (!fs::is_directory(path)) {
+			return false;
+		}
+		return findFusionRoot(path).has_value();
+	}
 }
\ No newline at end of file
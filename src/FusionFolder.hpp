@@ -3,49 +3,11 @@
 #define FUSIONFOLDER_H
 
 #include "ProcessedFolder.hpp"
+#include "TileIndex.hpp"
+#include "TopoScaleTable.hpp"
+#include "RasterRepair.hpp"
 
 namespace processedfolder {
-	//Repairs an issue that emerges in certain fusion runs where the resolution (and by extension, the origin and extent) get slightly messed up
-	//You specify an expected resolution and origin and a tolerance. If the actual resolution is farther from the expected than the tolerance, the raster is considered unrepairable and an exception is thrown
-	//Otherwise, the resolution is set to be the expected resolution and the extent is snapped to the grid inferred from the origin and resolution
-	template<class T>
-	lapis::Raster<T> repairResolution(const lapis::Raster<T>& r, lapis::coord_t expectedXRes, lapis::coord_t expectedYRes, lapis::coord_t expectedXOrigin, lapis::coord_t expectedYOrigin, double tolerance = 0.1) {
-		if (r.xres() == expectedXRes && r.yres() == expectedYRes) {
-			return(r);
-		}
-		
-		auto xmin = r.xmin();
-		auto ymin = r.ymin();
-		auto xres = r.xres();
-		auto yres = r.yres();
-		if (r.xres() != expectedXRes) {
-			if (std::abs(r.xres() - expectedXRes) / expectedXRes < tolerance) {
-				xmin = std::round((r.xmin() - expectedXOrigin) / expectedXRes) * expectedXRes;
-				xres = expectedXRes;
-			}
-			else {
-				throw lapis::AlignmentMismatchException("Raster not repairable");
-			}
-		}
-		if (r.yres() != expectedYRes) {
-			if (std::abs(r.yres() - expectedYRes) / expectedYRes < tolerance) {
-				ymin = std::round((r.ymin() - expectedYOrigin) / expectedYRes) * expectedYRes;
-				yres = expectedYRes;
-			}
-			else {
-				throw lapis::AlignmentMismatchException("Raster not repairable");
-			}
-		}
-		
-		lapis::Alignment a{ xmin, ymin, r.nrow(), r.ncol(), xres, yres, r.crs() };
-		lapis::Raster<T> out{ a };
-		for (lapis::cell_t c = 0; c < out.ncell(); ++c) {
-			out[c].value() = r[c].value();
-			out[c].has_value() = r[c].has_value();
-		}
-		return(out);
-	}
-
 	class FusionFolder : public ProcessedFolder {
 	public:
 
@@ -76,14 +38,17 @@ namespace processedfolder {
 
 		std::optional<lapis::Extent> extentByTile(size_t index) const override;
 
-		lapis::VectorDataset<lapis::Point> allHighPoints() const override;
+		lapis::VectorDataset<lapis::Point> allHighPoints(GeometryMode mode = GeometryMode::full) const override;
 		std::optional<std::filesystem::path> highPoints(size_t index) const override;
-		lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e) const override;
+		lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const override;
 
-		lapis::VectorDataset<lapis::MultiPolygon> allPolygons() const override;
-		lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e) const override;
+		lapis::VectorDataset<lapis::MultiPolygon> allPolygons(GeometryMode mode = GeometryMode::full) const override;
+		lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const override;
 		std::optional<std::filesystem::path> polygons(size_t index) const override;
 
+		TileCursor<lapis::Point> highPointCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const override;
+		TileCursor<lapis::MultiPolygon> polygonCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const override;
+
 		std::optional<std::filesystem::path> watershedSegmentRaster(size_t index) const override;
 		std::optional<lapis::Raster<lapis::taoid_t>> watershedSegmentRaster(const lapis::Extent& e) const override;
 
@@ -96,6 +61,7 @@ namespace processedfolder {
 		std::optional<std::filesystem::path> csmRaster(size_t index) const override;
 		std::optional<lapis::Raster<lapis::csm_t>> csmRaster(const lapis::Extent& e) const override;
 
+
 		std::function<lapis::CoordXY(const lapis::ConstFeature<lapis::Point>&)> coordGetter() const override;
 		std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> heightGetter() const override;
 		std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> radiusGetter() const override;
@@ -105,6 +71,8 @@ namespace processedfolder {
 		std::filesystem::path _layoutPath;
 		lapis::VectorDataset<lapis::Polygon> _layout;
 		lapis::CoordRef _proj;
+		TileIndex _tileIndex;
+		std::unordered_map<std::string, std::shared_ptr<TopoScaleTable>> _topoTables; //keyed by product and resolution, e.g. slope_30METERS
 
 		mutable std::string _x = "";
 		mutable std::string _y = "";
@@ -113,8 +81,24 @@ namespace processedfolder {
 
 		std::optional<std::filesystem::path> _getMetric(const std::string& basename, const std::string& folderBaseName) const;
 		std::optional<std::filesystem::path> _getTopoMetric(const std::string& basename, lapis::coord_t radiusMeters) const;
+		void _buildTopoTables();
+		//resolves the TAO fields of a polygon file, and remembers them for the getters if they haven't been set yet
+		//throws FileNotFoundException if they can't be found
+		TaoFieldNames _deduceFieldNames(const std::vector<std::string>& fieldNames, const std::filesystem::path& file) const;
+		//the filter keeping the TAOs in a tile's file that belong to that tile and, if given, lie in e
+		//TAOs are placed by their high point fields rather than their geometry, so this works whether or not the geometry is read
+		OgrFilter _ownedFilter(size_t index, const std::filesystem::path& file, const std::optional<lapis::Extent>& e, GeometryMode mode) const;
 		std::optional<std::filesystem::path> _getTileMetric(const std::string& basename, size_t index) const;
+		TaoFieldResolver _taoFields() const override;
+		std::optional<lapis::Raster<float>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<float>& reader, const std::string& cacheName) const override;
+		std::optional<lapis::Raster<ScaledHeight>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<ScaledHeight>& reader, const std::string& cacheName) const override;
+		std::optional<VirtualMosaic<lapis::csm_t>> _heightMosaic(const lapis::Extent& e, TileProduct product, size_t maxBlocks) const override;
+		TaoTable _readTaoTable(size_t index, const std::filesystem::path& file) const override;
+		std::vector<size_t> _tilesOverlapping(const lapis::Extent& projE) const override;
 	};
+
+	//this checks for a Layout_shapefiles folder, either directly inside the path or inside its Products* and FINAL* subfolders
+	bool isFusionFolder(const std::filesystem::path& path);
 }
 
 #endif
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "LapisFolder.hpp"
+#include "TileMosaic.hpp"
+#include "OgrFilter.hpp"
 
 namespace processedfolder {
 	namespace fs = std::filesystem;
@@ -30,18 +32,18 @@ namespace processedfolder {
 		return folder / fileName;
 	}
 
-	static std::optional<fs::path> checkAllUnits(const fs::path& folder, const std::string& runName,
+	static std::optional<fs::path> checkAllUnits(const FileManifest& manifest, const fs::path& folder, const std::string& runName,
 		const std::string& tileName, const std::string& baseName) {
 		fs::path candidate = constructFullPathTif(folder, runName, tileName, baseName, "");
-		if (exists(candidate)) {
+		if (manifest.exists(candidate)) {
 			return candidate;
 		}
 		candidate = constructFullPathTif(folder, runName, tileName, baseName, "Meters");
-		if (exists(candidate)) {
+		if (manifest.exists(candidate)) {
 			return candidate;
 		}
 		candidate = constructFullPathTif(folder, runName, tileName, baseName, "Feet");
-		if (exists(candidate)) {
+		if (manifest.exists(candidate)) {
 			return candidate;
 		}
 		return std::optional<fs::path>();
@@ -56,8 +58,14 @@ namespace processedfolder {
 			throw std::runtime_error(folder.string() + " is not a Lapis run folder.");
 		}
 		_folder = folder;
-
-
+		_manifest = std::make_shared<FileManifest>(std::vector<fs::path>{
+			folder / "Layout",
+			folder / "PointMetrics",
+			folder / "Topography",
+			folder / "CanopyMetrics",
+			folder / "CanopySurfaceModel",
+			folder / "Intensity",
+			folder / "TreeApproximateObjects" });
 
 		fs::path iniFile = folder / "RunParameters" / "FullParameters.ini";
 		try {
@@ -72,6 +80,21 @@ namespace processedfolder {
 			throw std::runtime_error(folder.string() + " has an issue in FullParameters.ini");
 		}
 
+		std::regex deleteBefore{ "^" + _name + "_TopoPositionIndex_" };
+		std::regex deleteAfter{ "(Meters_Meters|Feet_Feet)\\.tif$" };
+		_tpiTable = std::make_shared<TopoScaleTable>(
+			[manifest = _manifest, topoFolder = folder / "Topography"]() { return manifest->filesIn(topoFolder); },
+			[deleteBefore, deleteAfter](const std::string& fileName)->std::optional<coord_t> {
+				std::string scaleName = std::regex_replace(fileName, deleteBefore, "");
+				scaleName = std::regex_replace(scaleName, deleteAfter, "");
+				try {
+					return std::stod(scaleName);
+				}
+				catch (std::logic_error e) {
+					return std::nullopt;
+				}
+			});
+
 		auto extentFromLayer = [](OGRLayer* layer) {
 			OGREnvelope envelope;
 			layer->GetExtent(&envelope, true);
@@ -130,6 +153,16 @@ namespace processedfolder {
 		return _name;
 	}
 
+	void LapisFolder::refresh()
+	{
+		_manifest->refresh();
+		_tpiTable->refresh();
+		_taoIdLookups->clear();
+		if (_tileCache) {
+			_tileCache->clear();
+		}
+	}
+
 	std::optional<fs::path> LapisFolder::cover(bool allReturns) const
 	{
 		return _getMetricByName("CanopyCover", allReturns);
@@ -179,29 +212,7 @@ namespace processedfolder {
 	std::optional<fs::path> LapisFolder::tpi(lapis::coord_t radius, lapis::LinearUnit unit) const
 	{
 		auto converter = lapis::LinearUnitConverter(unit, units());
-		radius = converter(radius);
-
-		fs::path topoFolder = _folder / "Topography";
-		if (!fs::exists(topoFolder)) {
-			return std::optional<fs::path>();
-		}
-		std::regex deleteBefore{ "^" + _name + "_TopoPositionIndex_" };
-		std::regex deleteAfter{ "(Meters_Meters|Feet_Feet)\\.tif$" };
-		for (const auto& fn : fs::directory_iterator(topoFolder)) {
-			std::string scaleName = fn.path().filename().string();
-			scaleName = std::regex_replace(scaleName, deleteBefore, "");
-			scaleName = std::regex_replace(scaleName, deleteAfter, "");
-			try {
-				lapis::coord_t scale = std::stod(scaleName);
-				if (std::abs(scale - radius) < 1) {
-					return fn.path();
-				}
-			}
-			catch (std::invalid_argument e) {
-				continue;
-			}
-		}
-		return std::optional<fs::path>();
+		return _tpiTable->nearest(converter(radius), 1);
 	}
 
 	std::optional<fs::path> LapisFolder::maskRaster(bool allReturns) const
@@ -225,7 +236,7 @@ namespace processedfolder {
 	std::optional<fs::path> LapisFolder::tileLayoutVector() const
 	{
 		fs::path layoutPath = _folder / "Layout" / "TileLayout.shp";
-		if (fs::exists(layoutPath)) {
+		if (_manifest->exists(layoutPath)) {
 			return layoutPath;
 		}
 		return std::optional<fs::path>();
@@ -300,7 +311,7 @@ namespace processedfolder {
 
 	std::optional<lapis::Alignment> LapisFolder::metricAlignment() const {
 		auto checkCandidate = [&](const fs::path& c) {
-			if (!fs::exists(c)) {
+			if (!_manifest->exists(c)) {
 				return std::optional<lapis::Alignment>();
 			}
 			std::optional<lapis::Alignment> a = lapis::Alignment(c.string());
@@ -374,7 +385,7 @@ namespace processedfolder {
 		return extentByTile(_layoutRaster.cellFromRowColUnsafe(row, col));
 	}
 
-	lapis::VectorDataset<lapis::Point> LapisFolder::allHighPoints() const
+	lapis::VectorDataset<lapis::Point> LapisFolder::allHighPoints(GeometryMode mode) const
 	{
 		auto ntile = nTiles();
 		std::optional<fs::path> file;
@@ -385,6 +396,11 @@ namespace processedfolder {
 				files.push_back(*file);
 			}
 		}
+		if (mode == GeometryMode::none) {
+			OgrFilter filter;
+			filter.geometry = mode;
+			return readAllFiltered<lapis::Point>(files, filter);
+		}
 		lapis::VectorDataset<lapis::Point> out(files);
 		return out;
 	}
@@ -402,12 +418,12 @@ namespace processedfolder {
 		fileName = fileName + "_" + tileNameFromTile(index) + ".shp";
 
 		fs::path candidate = _folder / "TreeApproximateObjects" / fileName;
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
 		}
 
 		candidate = _folder / "TreeApproximateObjects" / "Points" / fileName;
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
 		}
 
@@ -423,30 +439,28 @@ namespace processedfolder {
 		return highPoints(_layoutRaster.cellFromRowColUnsafe(row, col));
 	}
 
-	lapis::VectorDataset<lapis::Point> LapisFolder::highPoints(const lapis::Extent& e) const
+	lapis::VectorDataset<lapis::Point> LapisFolder::highPoints(const lapis::Extent& e, GeometryMode mode) const
 	{
-		lapis::VectorDataset<lapis::Point> full{};
+		lapis::VectorDataset<lapis::Point> out{};
+		bool outInit = false;
 
 		lapis::Extent projE = lapis::QuadExtent(e, _layoutRaster.crs()).outerExtent();
 		if (!projE.overlaps(_layoutRaster)) {
-			return full;
+			return out;
 		}
 
+		OgrFilter filter;
+		filter.geometry = mode;
+		if (mode == GeometryMode::full) {
+			filter.rect = projE;
+		}
+		else {
+			filter.where = [&](const std::vector<std::string>&) { return insideWhere("X", "Y", projE); };
+		}
 		for (auto cell : lapis::CellIterator(_layoutRaster, projE, lapis::SnapType::out)) {
 			std::optional<fs::path> filePath = highPoints(cell);
 			if (filePath) {
-				if (!full.nFeature()) {
-					full = lapis::VectorDataset<lapis::Point>(filePath.value());
-				}
-				else {
-					full.appendFile(filePath.value());
-				}
-			}
-		}
-		auto out = lapis::emptyVectorDatasetFromTemplate(full);
-		for (auto ft : full) {
-			if (e.contains(ft.getGeometry().x(), ft.getGeometry().y())) {
-				out.addFeature(ft);
+				appendFiltered(out, outInit, filePath.value(), filter);
 			}
 		}
 		return out;
@@ -463,19 +477,19 @@ namespace processedfolder {
 			};
 
 		fs::path candidate = _folder / "TreeApproximateObjects" / "FusionPolygons" / getName("FusionPolygons");
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
 		}
 		candidate = _folder / "TreeApproximateObjects" / "McGaugheyPolygons" / getName("McGaugheyPolygons");
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
 		}
 		candidate = _folder / "TreeApproximateObjects" / "McGaugheyPolygons" / "SegmentPolygons" / getName("McGaugheyPolygons");
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
         }
 		candidate = _folder / "TreeApproximateObjects" / "McGaughey" / "SegmentPolygons" / getName("Segments");
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
 		}
 		return std::optional<fs::path>();
@@ -490,7 +504,7 @@ namespace processedfolder {
 		return mcGaugheyPolygons(_layoutRaster.cellFromRowColUnsafe(row, col));
 	}
 
-	lapis::VectorDataset<lapis::MultiPolygon> LapisFolder::mcGaugheyPolygons(const lapis::Extent& e) const
+	lapis::VectorDataset<lapis::MultiPolygon> LapisFolder::mcGaugheyPolygons(const lapis::Extent& e, GeometryMode mode) const
 	{
 		lapis::VectorDataset<lapis::MultiPolygon> out{};
 		bool outInit = false;
@@ -500,28 +514,20 @@ namespace processedfolder {
 			return out;
 		}
 
+		//polygons belong to the query if their high point does, so the filter is on X and Y rather than the geometry
+		OgrFilter filter;
+		filter.where = [&](const std::vector<std::string>&) { return insideWhere("X", "Y", projE); };
+		filter.geometry = mode;
 		for (auto cell : lapis::CellIterator(_layoutRaster, projE, lapis::SnapType::out)) {
 			std::optional<fs::path> filePath = mcGaugheyPolygons(cell);
 			if (filePath) {
-				lapis::VectorDataset<lapis::MultiPolygon> thisPolygons{ filePath.value() };
-				if (thisPolygons.nFeature()) {
-					if (!outInit) {
-						out = lapis::emptyVectorDatasetFromTemplate(thisPolygons);
-						outInit = true;
-					}
-
-					for (lapis::ConstFeature<lapis::MultiPolygon> ft : thisPolygons) {
-						if (projE.contains(ft.getNumericField<lapis::coord_t>("X"), ft.getNumericField<lapis::coord_t>("Y"))) {
-							out.addFeature(ft);
-						}
-					}
-				}
+				appendFiltered(out, outInit, filePath.value(), filter);
 			}
 		}
 		return out;
 	}
 
-	lapis::VectorDataset<lapis::MultiPolygon> LapisFolder::allPolygons() const {
+	lapis::VectorDataset<lapis::MultiPolygon> LapisFolder::allPolygons(GeometryMode mode) const {
 		auto ntile = nTiles();
 		std::optional<fs::path> file;
 		std::vector<std::filesystem::path> files;
@@ -531,49 +537,50 @@ namespace processedfolder {
 				files.push_back(*file);
 			}
 		}
+		if (mode == GeometryMode::none) {
+			OgrFilter filter;
+			filter.geometry = mode;
+			return readAllFiltered<lapis::MultiPolygon>(files, filter);
+		}
 		lapis::VectorDataset<lapis::MultiPolygon> out(files);
 		return out;
 	}
 
-	lapis::VectorDataset<lapis::MultiPolygon> LapisFolder::polygons(const lapis::Extent& e) const {
-		return mcGaugheyPolygons(e);
+	lapis::VectorDataset<lapis::MultiPolygon> LapisFolder::polygons(const lapis::Extent& e, GeometryMode mode) const {
+		return mcGaugheyPolygons(e, mode);
 	}
 
 	std::optional<fs::path> LapisFolder::polygons(size_t index) const {
 		return mcGaugheyPolygons(index);
 	}
 
+	TileCursor<lapis::Point> LapisFolder::highPointCursor(bool readAhead, GeometryMode mode) const {
+		return fileCursor<lapis::Point>(nTiles(), [this](size_t i) { return highPoints(i); }, readAhead, mode);
+	}
+
+	TileCursor<lapis::MultiPolygon> LapisFolder::polygonCursor(bool readAhead, GeometryMode mode) const {
+		return fileCursor<lapis::MultiPolygon>(nTiles(), [this](size_t i) { return mcGaugheyPolygons(i); }, readAhead, mode);
+	}
+
+	//where tiles overlap, the first one read wins
 	template<class T>
-	std::optional<lapis::Raster<T>> fineDataByExtentGeneric(const lapis::Extent& e, const lapis::Raster<bool>& tileLayout, std::function<std::optional<fs::path>(size_t)> byTile) {
-		std::optional<lapis::Raster<T>> out{};
+	static void overlayTile(lapis::Raster<T>& out, const lapis::Raster<T>& tile) {
+		out.overlay(tile, [](T a, T b) {return a; });
+	}
 
+	template<class T>
+	std::optional<lapis::Raster<T>> fineDataByExtentGeneric(const lapis::Extent& e, const lapis::Raster<bool>& tileLayout, std::function<std::optional<fs::path>(size_t)> byTile,
+		TileCache* cache, const std::string& product, const TileReader<T>& reader = nullptr) {
 		lapis::Extent projE = lapis::QuadExtent(e, tileLayout.crs()).outerExtent();
 		if (!projE.overlaps(tileLayout)) {
 			return std::optional<lapis::Raster<T>>{};
 		}
 
+		std::vector<size_t> tiles;
 		for (auto cell : lapis::CellIterator(tileLayout, projE, lapis::SnapType::out)) {
-			std::optional<fs::path> filePath = byTile(cell);
-			if (!filePath) {
-				continue;
-			}
-			try {
-				if (!out.has_value()) {
-					lapis::Alignment a{ filePath.value().string() };
-					a.defineCRS(tileLayout.crs());
-					a = extendAlignment(a, projE, lapis::SnapType::out);
-					a = cropAlignment(a, projE, lapis::SnapType::out);
-					out = lapis::Raster<T>{ a };
-				}
-				lapis::Raster<T> tile{ filePath.value().string(), projE, lapis::SnapType::out };
-				tile.defineCRS(tileLayout.crs());
-				out->overlay(tile, [](T a, T b) {return a; });
-			}
-			catch (lapis::LapisGisException e) {
-				continue;
-			}
+			tiles.push_back(cell);
 		}
-		return out;
+		return mosaicTiles<T>(projE, tileLayout.crs(), tiles, byTile, overlayTile<T>, cache, product, reader);
 	}
 
 
@@ -585,7 +592,7 @@ namespace processedfolder {
 
 		auto checkFolder = [&](const fs::path& folder)->std::optional<fs::path> {
 			fs::path candidate = constructFullPathTif(folder, name(), tileNameFromTile(index), "Segments", "");
-			if (fs::exists(candidate)) {
+			if (_manifest->exists(candidate)) {
 				return candidate;
 			}
 			return std::nullopt;
@@ -614,7 +621,7 @@ namespace processedfolder {
 	}
 
 	std::optional<lapis::Raster<lapis::taoid_t>> LapisFolder::watershedSegmentRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<lapis::taoid_t>(e, _layoutRaster, [&](size_t n) { return watershedSegmentRaster(n); });
+		return fineDataByExtentGeneric<lapis::taoid_t>(e, _layoutRaster, [&](size_t n) { return watershedSegmentRaster(n); }, _tileCache.get(), "segments");
 	}
 
 	std::optional<fs::path> LapisFolder::intensityRaster(size_t index) const
@@ -623,11 +630,11 @@ namespace processedfolder {
 			return std::nullopt;
 		}
 		fs::path candidate = constructFullPathTif(dir() / "Intensity", name(), tileNameFromTile(index), "MeanCanopyIntensity", "");
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
 		}
 		candidate = constructFullPathTif(dir() / "Intensity", name(), tileNameFromTile(index), "MeanIntensity", "");
-		if (fs::exists(candidate)) {
+		if (_manifest->exists(candidate)) {
 			return candidate;
 		}
 		return std::nullopt;
@@ -642,7 +649,7 @@ namespace processedfolder {
 	}
 
 	std::optional<lapis::Raster<lapis::intensity_t>> LapisFolder::intensityRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<lapis::intensity_t>(e, _layoutRaster, [&](size_t n) { return intensityRaster(n); });
+		return fineDataByExtentGeneric<lapis::intensity_t>(e, _layoutRaster, [&](size_t n) { return intensityRaster(n); }, _tileCache.get(), "intensity");
 	}
 
 	std::optional<fs::path> LapisFolder::maxHeightRaster(size_t index) const
@@ -651,11 +658,11 @@ namespace processedfolder {
 			return std::nullopt;
 		}
 		auto checkFolder = [&](const fs::path& folder)->std::optional<fs::path> {
-			std::optional<fs::path> candidate = checkAllUnits(folder, name(), tileNameFromTile(index), "MaxHeight");
+			std::optional<fs::path> candidate = checkAllUnits(*_manifest, folder, name(), tileNameFromTile(index), "MaxHeight");
 			if (candidate) {
 				return candidate;
 			}
-			candidate = checkAllUnits(folder, name(), tileNameFromTile(index), "TaoHeight");
+			candidate = checkAllUnits(*_manifest, folder, name(), tileNameFromTile(index), "TaoHeight");
 			if (candidate) {
 				return candidate;
 			}
@@ -685,7 +692,7 @@ namespace processedfolder {
 	}
 
 	std::optional<lapis::Raster<lapis::csm_t>> LapisFolder::maxHeightRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<lapis::csm_t>(e, _layoutRaster, [&](size_t n) { return maxHeightRaster(n); });
+		return fineDataByExtentGeneric<lapis::csm_t>(e, _layoutRaster, [&](size_t n) { return maxHeightRaster(n); }, _tileCache.get(), "maxHeight");
 	}
 
 
@@ -694,7 +701,7 @@ namespace processedfolder {
 		if (index < 0 || index >= (size_t)_layoutRaster.ncell()) {
 			return std::optional<fs::path>();
 		}
-		return checkAllUnits(_folder / "CanopySurfaceModel", name(), tileNameFromTile(index), "CanopySurfaceModel");
+		return checkAllUnits(*_manifest, _folder / "CanopySurfaceModel", name(), tileNameFromTile(index), "CanopySurfaceModel");
 	}
 
 	std::optional<fs::path> LapisFolder::csmRaster(lapis::rowcol_t row, lapis::rowcol_t col) const
@@ -706,7 +713,21 @@ namespace processedfolder {
 	}
 
 	std::optional<lapis::Raster<lapis::csm_t>> LapisFolder::csmRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<lapis::csm_t>(e, _layoutRaster, [&](size_t n) { return csmRaster(n); });
+		return fineDataByExtentGeneric<lapis::csm_t>(e, _layoutRaster, [&](size_t n) { return csmRaster(n); }, _tileCache.get(), "csm");
+	}
+
+	std::optional<lapis::Raster<float>> LapisFolder::_reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<float>& reader, const std::string& cacheName) const {
+		return fineDataByExtentGeneric<float>(e, _layoutRaster, [&](size_t n) { return tileFile(product, n); }, _tileCache.get(), cacheName, reader);
+	}
+
+	std::optional<lapis::Raster<ScaledHeight>> LapisFolder::_reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<ScaledHeight>& reader, const std::string& cacheName) const {
+		return fineDataByExtentGeneric<ScaledHeight>(e, _layoutRaster, [&](size_t n) { return tileFile(product, n); }, _tileCache.get(), cacheName, reader);
+	}
+
+	std::optional<VirtualMosaic<lapis::csm_t>> LapisFolder::_heightMosaic(const lapis::Extent& e, TileProduct product, size_t maxBlocks) const {
+		lapis::Extent projE = lapis::QuadExtent(e, _layoutRaster.crs()).outerExtent();
+		return openVirtualMosaic<lapis::csm_t>(projE, _layoutRaster.crs(), _tilesOverlapping(projE), [this](size_t n) { return extentByTile(n); },
+			[this, product](size_t n) { return tileFile(product, n); }, overlayTile<lapis::csm_t>, maxBlocks);
 	}
 
 	std::optional<fs::path> LapisFolder::_getMetricByName(const std::string& name, bool preferAllReturns) const
@@ -722,8 +743,8 @@ namespace processedfolder {
 		std::string runNameWithUnderscore = _name.size() ? (_name + "_") : "";
 		for (const fs::path& folder : folders) {
 			for (const std::string& unit : possibleUnits) {
-				fs::path candidate = _folder / folder / (runNameWithUnderscore + name + unit + ".tif");
-				if (fs::exists(candidate)) {
+				fs::path candidate = folder / (runNameWithUnderscore + name + unit + ".tif");
+				if (_manifest->exists(candidate)) {
 					return candidate;
 				}
 			}
@@ -731,6 +752,30 @@ namespace processedfolder {
 		return std::optional<fs::path>();
 	}
 
+	TaoFieldResolver LapisFolder::_taoFields() const
+	{
+		return standardTaoFields;
+	}
+
+	TaoTable LapisFolder::_readTaoTable(size_t index, const fs::path& file) const
+	{
+		TaoTable out;
+		readTaoFile(file, standardTaoFields, (uint32_t)index, out);
+		return out;
+	}
+
+	std::vector<size_t> LapisFolder::_tilesOverlapping(const lapis::Extent& projE) const
+	{
+		std::vector<size_t> out;
+		if (!projE.overlaps(_layoutRaster)) {
+			return out;
+		}
+		for (auto cell : lapis::CellIterator(_layoutRaster, projE, lapis::SnapType::out)) {
+			out.push_back(cell);
+		}
+		return out;
+	}
+
 	std::function<lapis::CoordXY(const lapis::ConstFeature<lapis::Point>&)> LapisFolder::coordGetter() const {
 		return [](const lapis::ConstFeature<lapis::Point>& ft)->lapis::CoordXY {
 			return { ft.getNumericField<lapis::coord_t>("X"), ft.getNumericField<lapis::coord_t>("Y") };
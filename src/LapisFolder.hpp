@@ -3,6 +3,8 @@
 #define LAPISFOLDER_H
 
 #include "ProcessedFolder.hpp"
+#include "FileManifest.hpp"
+#include "TopoScaleTable.hpp"
 
 namespace processedfolder {
 	class LapisFolder : public ProcessedFolder {
@@ -13,6 +15,9 @@ namespace processedfolder {
 		const std::filesystem::path dir() const override;
 		const std::string& name() const;
 
+		//relists the run's files; use this if the run was still being written when the folder was opened
+		void refresh();
+
 		std::optional<std::filesystem::path> cover(bool allReturns = true) const override;
 		std::optional<std::filesystem::path> p95(bool allReturns = true) const override;
 		std::optional<std::filesystem::path> rumple(bool allReturns = true) const override;
@@ -46,19 +51,22 @@ namespace processedfolder {
 		std::optional<lapis::Extent> extentByTile(size_t index) const override;
 		std::optional<lapis::Extent> extentByTile(lapis::rowcol_t row, lapis::rowcol_t col) const;
 
-		lapis::VectorDataset<lapis::Point> allHighPoints() const override;
+		lapis::VectorDataset<lapis::Point> allHighPoints(GeometryMode mode = GeometryMode::full) const override;
 		std::optional<std::filesystem::path> highPoints(size_t index) const override;
 		std::optional<std::filesystem::path> highPoints(lapis::rowcol_t row, lapis::rowcol_t col) const;
-		lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e) const;
+		lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const;
 
 		std::optional<std::filesystem::path> mcGaugheyPolygons(size_t index) const;
 		std::optional<std::filesystem::path> mcGaugheyPolygons(lapis::rowcol_t row, lapis::rowcol_t col) const;
-		lapis::VectorDataset<lapis::MultiPolygon> mcGaugheyPolygons(const lapis::Extent& e) const;
+		lapis::VectorDataset<lapis::MultiPolygon> mcGaugheyPolygons(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const;
 
-		lapis::VectorDataset<lapis::MultiPolygon> allPolygons() const override;
-		lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e) const override;
+		lapis::VectorDataset<lapis::MultiPolygon> allPolygons(GeometryMode mode = GeometryMode::full) const override;
+		lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const override;
 		std::optional<std::filesystem::path> polygons(size_t index) const override;
 
+		TileCursor<lapis::Point> highPointCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const override;
+		TileCursor<lapis::MultiPolygon> polygonCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const override;
+
 		std::optional<std::filesystem::path> watershedSegmentRaster(size_t index) const override;
 		std::optional<std::filesystem::path> watershedSegmentRaster(lapis::rowcol_t row, lapis::rowcol_t col) const;
 		std::optional<lapis::Raster<lapis::taoid_t>> watershedSegmentRaster(const::lapis::Extent& e) const;
@@ -75,6 +83,7 @@ namespace processedfolder {
 		std::optional<std::filesystem::path> csmRaster(lapis::rowcol_t row, lapis::rowcol_t col) const;
 		std::optional<lapis::Raster<lapis::csm_t>> csmRaster(const lapis::Extent& e) const override;
 
+
 		std::function<lapis::CoordXY(const lapis::ConstFeature<lapis::Point>&)> coordGetter() const override;
 		std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> heightGetter() const override;
 		std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> radiusGetter() const override;
@@ -83,8 +92,17 @@ namespace processedfolder {
 		std::filesystem::path _folder;
 		lapis::Raster<bool> _layoutRaster;
 		std::string _name;
+		std::shared_ptr<FileManifest> _manifest;
+		std::shared_ptr<TopoScaleTable> _tpiTable;
 
 		std::optional<std::filesystem::path> _getMetricByName(const std::string& baseName, bool allReturns = true) const;
+
+		TaoFieldResolver _taoFields() const override;
+		std::optional<lapis::Raster<float>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<float>& reader, const std::string& cacheName) const override;
+		std::optional<lapis::Raster<ScaledHeight>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<ScaledHeight>& reader, const std::string& cacheName) const override;
+		std::optional<VirtualMosaic<lapis::csm_t>> _heightMosaic(const lapis::Extent& e, TileProduct product, size_t maxBlocks) const override;
+		TaoTable _readTaoTable(size_t index, const std::filesystem::path& file) const override;
+		std::vector<size_t> _tilesOverlapping(const lapis::Extent& projE) const override;
 	};
 
 	//this checks for two things: the presence of TileLayout.shp, and the presence of FullParameters.ini
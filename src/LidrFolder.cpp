@@ -1,4 +1,9 @@
 #include "LidRFolder.hpp"
+#include "TileMosaic.hpp"
+#include "OgrFilter.hpp"
+#include "Parallel.hpp"
+#include "BasinPolygons.hpp"
+#include "TempFile.hpp"
 
 namespace processedfolder {
 	namespace fs = std::filesystem;
@@ -13,11 +18,16 @@ namespace processedfolder {
 		_folder = folder;
 		_layout = lapis::VectorDataset<lapis::MultiPolygon>((_folder / "layout" / "layout.shp").string());
 
-		if (!fs::exists(_folder / "mask")) {
-			return;
+		if (fs::exists(_folder / "mask")) {
+			_proj = lapis::Alignment(maskRaster().value().string()).crs();
+			_layout.projectInPlace(_proj);
 		}
-		_proj = lapis::Raster<int>(maskRaster().value().string()).crs();
-		_layout.projectInPlace(_proj);
+
+		std::vector<lapis::Extent> tileExtents;
+		for (size_t i = 0; i < _layout.nFeature(); ++i) {
+			tileExtents.push_back(_layout.getFeature(i).getGeometry().boundingBox());
+		}
+		_tileIndex = TileIndex(tileExtents);
 	}
 
 	const fs::path LidRFolder::dir() const
@@ -111,13 +121,26 @@ namespace processedfolder {
 		if (index < 0 || index >= nTiles()) {
 			return std::optional<lapis::Extent>();
 		}
-		return _layout.getFeature(index).getGeometry().boundingBox();
+		return _tileIndex.tileExtent(index);
 	}
 
-	lapis::VectorDataset<lapis::Point> LidRFolder::allHighPoints() const {
-		std::cout << "WARNING: Needs implementation\n";
-        throw std::logic_error("Not implemented");
-		return lapis::VectorDataset<lapis::Point>();
+	lapis::VectorDataset<lapis::Point> LidRFolder::allHighPoints(GeometryMode mode) const {
+		auto ntile = nTiles();
+		std::optional<fs::path> file;
+		std::vector<std::filesystem::path> files;
+		for (size_t cell = 0; cell < ntile; ++cell) {
+			file = highPoints(cell);
+			if (file) {
+				files.push_back(*file);
+			}
+		}
+		if (mode == GeometryMode::none) {
+			OgrFilter filter;
+			filter.geometry = mode;
+			return readAllFiltered<lapis::Point>(files, filter);
+		}
+		lapis::VectorDataset<lapis::Point> out(files);
+		return out;
 	}
 
 	std::optional<fs::path> LidRFolder::highPoints(size_t index) const {
@@ -144,73 +167,42 @@ namespace processedfolder {
 		}
 
 		try {
-			lapis::VectorDataset<lapis::Point> out{};
-			out.addNumericField<lapis::coord_t>("X");
-			out.addNumericField<lapis::coord_t>("Y");
-			out.addNumericField<lapis::csm_t>("Height");
-			out.addNumericField<lapis::coord_t>("Area");
-
-			auto basin = lapis::Raster<int>(stringOrThrow(watershedSegmentRaster(index)));
-			auto chm = lapis::Raster<lapis::csm_t>(stringOrThrow(csmRaster(index)));
-			auto tops = lapis::Raster<uint8_t>(stringOrThrow(topsRaster(index)));
-
-			std::map<int, lapis::csm_t> map;
-			for (lapis::cell_t c = 0; c < basin.ncell(); c++) {
-				if (basin[c].has_value()) {
-					map.emplace(basin[c].value(), 0);
-					++map[basin[c].value()];
-				}
-			}
-			auto convarea = basin.xres() * basin.yres();
-			for (lapis::cell_t c = 0; c < tops.ncell(); c++) {
-				if (tops[c].has_value() && tops[c].value()) {
-					lapis::Point pt{ tops.xFromCell(c), tops.yFromCell(c) };
-					out.addGeometry(pt);
-					out.back().setNumericField<lapis::coord_t>("X", pt.x());
-					out.back().setNumericField<lapis::coord_t>("Y", pt.y());
-					out.back().setNumericField<lapis::csm_t>("Height", chm[c].value());
-					out.back().setNumericField<lapis::coord_t>("Area", map[basin[c].value()] * convarea);
-				}
-			}
-			out.writeShapefile(expected.string());
+			_deriveSegmentProducts(index);
 		}
 		catch (FileNotFoundException e) {
 			std::cerr << "Did not find data for" << _layout.getStringField(index, "uniqueid") << ".\n";
 			return std::optional<fs::path>();
-
 		}
-		return expected;
+		return _derivedPath(index, "_highPoints.shp");
 	}
 
-	lapis::VectorDataset<lapis::Point> LidRFolder::highPoints(const lapis::Extent& e) const {
-		lapis::VectorDataset<lapis::Point> full{};
+	lapis::VectorDataset<lapis::Point> LidRFolder::highPoints(const lapis::Extent& e, GeometryMode mode) const {
+		lapis::VectorDataset<lapis::Point> out{};
+		bool outInit = false;
 
 		lapis::Extent projE = lapis::QuadExtent(e, _layout.crs()).outerExtent();
 		if (!projE.overlaps(_layout.extent())) {
-			return full;
+			return out;
 		}
 
-		for (size_t i = 0; i < _layout.nFeature(); ++i) {
+		OgrFilter filter;
+		filter.geometry = mode;
+		if (mode == GeometryMode::full) {
+			filter.rect = projE;
+		}
+		else {
+			filter.where = [&](const std::vector<std::string>&) { return insideWhere("X", "Y", projE); };
+		}
+		for (size_t i : _tileIndex.overlapping(projE)) {
 			std::optional<fs::path> filePath = highPoints(i);
 			if (filePath) {
-				if (!full.nFeature()) {
-					full = lapis::VectorDataset<lapis::Point>(filePath.value());
-				}
-				else {
-					full.appendFile(filePath.value());
-				}
-			}
-		}
-		auto out = lapis::emptyVectorDatasetFromTemplate(full);
-		for (lapis::ConstFeature<lapis::Point> ft : full) {
-			if (e.contains(ft.getGeometry().x(), ft.getGeometry().y())) {
-				out.addFeature(ft);
+				appendFiltered(out, outInit, filePath.value(), filter);
 			}
 		}
 		return out;
 	}
 
-	lapis::VectorDataset<lapis::MultiPolygon> LidRFolder::allPolygons() const {
+	lapis::VectorDataset<lapis::MultiPolygon> LidRFolder::allPolygons(GeometryMode mode) const {
 		auto ntile = nTiles();
 		std::optional<fs::path> file;
 		std::vector<std::filesystem::path> files;
@@ -220,11 +212,16 @@ namespace processedfolder {
 				files.push_back(*file);
 			}
 		}
+		if (mode == GeometryMode::none) {
+			OgrFilter filter;
+			filter.geometry = mode;
+			return readAllFiltered<lapis::MultiPolygon>(files, filter);
+		}
 		lapis::VectorDataset<lapis::MultiPolygon> out(files);
 		return out;
 	}
 
-	lapis::VectorDataset<lapis::MultiPolygon> LidRFolder::polygons(const lapis::Extent& e) const {
+	lapis::VectorDataset<lapis::MultiPolygon> LidRFolder::polygons(const lapis::Extent& e, GeometryMode mode) const {
 		lapis::VectorDataset<lapis::MultiPolygon> out{};
 		bool outInit = false;
 
@@ -233,27 +230,19 @@ namespace processedfolder {
 			return out;
 		}
 
-		for (size_t i = 0; i < _layout.nFeature(); ++i) {
+		for (size_t i : _tileIndex.overlapping(projE)) {
+			auto tileExtent = extentByTile(i).value();
+			if (!projE.overlaps(tileExtent)) {
+				continue;
+			}
 			std::optional<fs::path> filePath = polygons(i);
 			if (filePath) {
-				auto tileExtent = extentByTile(i).value();
-				if (!projE.overlaps(tileExtent)) {
-					continue;
-				}
-				lapis::VectorDataset<lapis::MultiPolygon> thisPolygons{ filePath.value() };
-				if (thisPolygons.nFeature()) {
-					if (!outInit) {
-						out = lapis::emptyVectorDatasetFromTemplate(thisPolygons);
-					}
-
-					for (lapis::ConstFeature<lapis::MultiPolygon> ft : thisPolygons) {
-						if (projE.contains(ft.getNumericField<lapis::coord_t>("X"), ft.getNumericField<lapis::coord_t>("Y"))) {
-							if (tileExtent.contains(ft.getNumericField<lapis::coord_t>("X"), ft.getNumericField<lapis::coord_t>("Y"))) {
-								out.addFeature(ft);
-							}
-						}
-					}
-				}
+				OgrFilter filter;
+				filter.where = [&](const std::vector<std::string>&) {
+					return insideWhere("X", "Y", projE) + " AND " + insideWhere("X", "Y", tileExtent);
+					};
+				filter.geometry = mode;
+				appendFiltered(out, outInit, filePath.value(), filter);
 			}
 		}
 		return out;
@@ -283,90 +272,38 @@ namespace processedfolder {
 		}
 
 		try {
-			auto basin = lapis::Raster<int>(stringOrThrow(watershedSegmentRaster(index)));
-			auto chm = lapis::Raster <lapis::coord_t> (stringOrThrow(csmRaster(index)));
-			auto tops = lapis::Raster<uint8_t>(stringOrThrow(topsRaster(index)));
-
-			auto out = lapis::rasterToMultiPolygonForTaos(basin);
-			out.addNumericField<lapis::coord_t>("X");
-			out.addNumericField<lapis::coord_t>("Y");
-			out.addNumericField<lapis::csm_t>("Height");
-			out.addNumericField<lapis::coord_t>("Area");
-
-			std::unordered_map<int, lapis::csm_t> aMap;
-			for (lapis::cell_t c = 0; c < basin.ncell(); c++) {
-				if (basin[c].has_value()) {
-					aMap.emplace(basin[c].value(), 0);
-					++aMap[basin[c].value()];
-				}
-			}
-			
-			std::unordered_map<int, lapis::coord_t> xMap;
-			std::unordered_map<int, lapis::coord_t> yMap;
-			std::unordered_map<int, lapis::coord_t> hMap;
-			for (lapis::cell_t c = 0; c < tops.ncell(); ++c) {
-				if (tops[c].has_value() && tops[c].value()) {
-					auto x = tops.xFromCell(c);
-					auto y = tops.yFromCell(c);
-					basin.extract(x, y, lapis::ExtractMethod::near);
-					/*if (id.has_value()) {
-						auto h = chm.extract(x, y, lapis::ExtractMethod::near);
-						xMap.emplace(id.value(), x);
-						yMap.emplace(id.value(), y);
-						hMap.emplace(id.value(), h.value());
-					}*/
-				}
-			}
-			
-			auto convarea = basin.xres() * basin.yres();
-			for (auto ft : out) {
-				auto id = ft.getNumericField<int>("ID");
-				ft.setNumericField<lapis::coord_t>("X", xMap[id]);
-				ft.setNumericField<lapis::coord_t>("y", yMap[id]);
-				ft.setNumericField<lapis::csm_t>("Height", hMap[id]);
-				ft.setNumericField<lapis::coord_t>("Area", aMap[id]);
-			}
-			out.writeShapefile(expected.string());
+			_deriveSegmentProducts(index);
 		}
 		catch (FileNotFoundException e) {
 			std::cerr << "Did not find data for" << _layout.getStringField(index, "uniqueid") << ".\n";
 			return std::optional<fs::path>();
-
 		}
-		return expected;
+		return _derivedPath(index, "_polygons.shp");
 	}
 
+	//where tiles overlap, the first one read wins
 	template<class T>
-	std::optional<lapis::Raster<T>> fineDataByExtentGeneric(const lapis::Extent& e, const lapis::VectorDataset<lapis::MultiPolygon>& tileLayout, std::function<std::optional<fs::path>(size_t)> byTile) {
-		std::optional<lapis::Raster<T>> out{};
+	static void overlayTile(lapis::Raster<T>& out, const lapis::Raster<T>& tile) {
+		out.overlay(tile, [](T a, T b) {return a; });
+	}
 
+	template<class T>
+	std::optional<lapis::Raster<T>> fineDataByExtentGeneric(const lapis::Extent& e, const lapis::VectorDataset<lapis::MultiPolygon>& tileLayout, const TileIndex& tileIndex,
+		std::function<std::optional<fs::path>(size_t)> byTile, TileCache* cache, const std::string& product, const TileReader<T>& reader = nullptr) {
 		lapis::Extent projE = lapis::QuadExtent(e, tileLayout.crs()).outerExtent();
 		if (!projE.overlaps(tileLayout.extent())) {
 			return std::optional<lapis::Raster<T>>{};
 		}
 
-		for (size_t i = 0; i < tileLayout.nFeature(); ++i) {
-			std::optional<fs::path> filePath = byTile(i);
-			if (!filePath) {
-				continue;
-			}
-			try {
-				if (!out.has_value()) {
-					lapis::Alignment a{ filePath.value().string() };
-					a.defineCRS(tileLayout.crs());
-					a = extendAlignment(a, projE, lapis::SnapType::out);
-					a = cropAlignment(a, projE, lapis::SnapType::out);
-					out = lapis::Raster<T>{ a };
-				}
-				lapis::Raster<T> tile{ filePath.value().string(), projE, lapis::SnapType::out };
-				tile.defineCRS(tileLayout.crs());
-				out->overlay(tile, [](T a, T b) {return a; });
-			}
-			catch (lapis::LapisGisException e) {
-				continue;
-			}
-		}
-		return out;
+		return mosaicTiles<T>(projE, tileLayout.crs(), tileIndex.overlapping(projE), byTile, overlayTile<T>, cache, product, reader);
+	}
+
+	TileCursor<lapis::Point> LidRFolder::highPointCursor(bool readAhead, GeometryMode mode) const {
+		return fileCursor<lapis::Point>(nTiles(), [this](size_t i) { return highPoints(i); }, readAhead, mode);
+	}
+
+	TileCursor<lapis::MultiPolygon> LidRFolder::polygonCursor(bool readAhead, GeometryMode mode) const {
+		return fileCursor<lapis::MultiPolygon>(nTiles(), [this](size_t i) { return polygons(i); }, readAhead, mode);
 	}
 
 	std::optional<fs::path> LidRFolder::topsRaster(size_t index) const {
@@ -394,7 +331,14 @@ namespace processedfolder {
 	}
 
 	std::optional<lapis::Raster<uint8_t>> LidRFolder::topsRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<uint8_t>(e, _layout, [&](size_t n) { return topsRaster(n); });
+		return fineDataByExtentGeneric<uint8_t>(e, _layout, _tileIndex, [&](size_t n) { return topsRaster(n); }, _tileCache.get(), "tops");
+	}
+
+	std::optional<fs::path> LidRFolder::tileFile(TileProduct product, size_t index) const {
+		if (product == TileProduct::tops) {
+			return topsRaster(index);
+		}
+		return ProcessedFolder::tileFile(product, index);
 	}
 
 	std::optional<fs::path> LidRFolder::watershedSegmentRaster(size_t index) const {
@@ -423,7 +367,7 @@ namespace processedfolder {
 	}
 
 	std::optional<lapis::Raster<lapis::taoid_t>> LidRFolder::watershedSegmentRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<lapis::taoid_t>(e, _layout, [&](size_t n) { return watershedSegmentRaster(n); });
+		return fineDataByExtentGeneric<lapis::taoid_t>(e, _layout, _tileIndex, [&](size_t n) { return watershedSegmentRaster(n); }, _tileCache.get(), "segments");
 	}
 
 	std::optional<fs::path> LidRFolder::intensityRaster(size_t index) const {
@@ -456,31 +400,18 @@ namespace processedfolder {
 			}
 		}
 
-		std::cout << "creating mhm for first time access\n";
-		auto basin = lapis::Raster<int>(stringOrThrow(watershedSegmentRaster(index)));
-		auto chm = lapis::Raster<lapis::csm_t>(stringOrThrow(csmRaster(index)));
-		auto tops = lapis::Raster<int>(stringOrThrow(topsRaster(index)));
-
-		std::map<int, lapis::csm_t> map;
-		for (lapis::cell_t c = 0; c < tops.ncell(); c++) {
-			if (tops[c].has_value() && tops[c].value() == 1) {
-				auto b = basin[c].value();
-				auto ht = chm[c].value();
-				map.emplace(b, ht);
-			}
+		try {
+			_deriveSegmentProducts(index);
 		}
-		auto out = chm;
-		for (lapis::cell_t c = 0; c < out.ncell(); c++) {
-			if (basin[c].has_value()) {
-				out[c].value() = map[basin[c].value()];
-			}
+		catch (FileNotFoundException e) {
+			std::cerr << "Did not find data for" << _layout.getStringField(index, "uniqueid") << ".\n";
+			return std::optional<fs::path>();
 		}
-		out.writeRaster(expected.string());
-		return expected.string();
+		return _derivedPath(index, "_mhm.tif");
 	}
 
 	std::optional<lapis::Raster<lapis::csm_t>> LidRFolder::maxHeightRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, [&](size_t n) { return maxHeightRaster(n); });
+		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, _tileIndex, [&](size_t n) { return maxHeightRaster(n); }, _tileCache.get(), "maxHeight");
 	}
 
 	std::optional<fs::path> LidRFolder::csmRaster(size_t index) const {
@@ -508,7 +439,281 @@ namespace processedfolder {
 	}
 
 	std::optional<lapis::Raster<lapis::csm_t>> LidRFolder::csmRaster(const lapis::Extent& e) const {
-		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, [&](size_t n) { return csmRaster(n); });
+		return fineDataByExtentGeneric<lapis::csm_t>(e, _layout, _tileIndex, [&](size_t n) { return csmRaster(n); }, _tileCache.get(), "csm");
+	}
+
+	std::optional<lapis::Raster<float>> LidRFolder::_reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<float>& reader, const std::string& cacheName) const {
+		return fineDataByExtentGeneric<float>(e, _layout, _tileIndex, [&](size_t n) { return tileFile(product, n); }, _tileCache.get(), cacheName, reader);
+	}
+
+	std::optional<lapis::Raster<ScaledHeight>> LidRFolder::_reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<ScaledHeight>& reader, const std::string& cacheName) const {
+		return fineDataByExtentGeneric<ScaledHeight>(e, _layout, _tileIndex, [&](size_t n) { return tileFile(product, n); }, _tileCache.get(), cacheName, reader);
+	}
+
+	std::optional<VirtualMosaic<lapis::csm_t>> LidRFolder::_heightMosaic(const lapis::Extent& e, TileProduct product, size_t maxBlocks) const {
+		lapis::Extent projE = lapis::QuadExtent(e, _layout.crs()).outerExtent();
+		if (!projE.overlaps(_layout.extent())) {
+			return std::nullopt;
+		}
+		return openVirtualMosaic<lapis::csm_t>(projE, _layout.crs(), _tileIndex.overlapping(projE), [this](size_t n) { return extentByTile(n); },
+			[this, product](size_t n) { return tileFile(product, n); }, overlayTile<lapis::csm_t>, maxBlocks);
+	}
+
+	fs::path LidRFolder::_derivedPath(size_t index, const std::string& suffix) const {
+		return _folder / "segments" / (_layout.getStringField(index, "uniqueid") + suffix);
+	}
+
+	//Per-segment statistics for one tile, indexed by slot rather than by basin ID, so they live in flat arrays
+	struct SegmentStats {
+		std::vector<int> id;
+		std::vector<size_t> nCell;
+		std::vector<lapis::cell_t> topCell; //-1 if the segment has no top
+		std::vector<lapis::csm_t> topHeight;
+		std::vector<lapis::csm_t> maxHeight; //the highest CHM cell in the segment, used when it has no top
+	};
+	static constexpr size_t noSegment = std::numeric_limits<size_t>::max();
+
+	//the .shp is renamed last, since that's the file whose existence marks the shapefile as present
+	template<class T>
+	static void writeShapefileAtomically(const lapis::VectorDataset<T>& data, const fs::path& path) {
+		fs::path temp = temporaryPath(path);
+		data.writeShapefile(temp.string());
+		for (const char* ext : { ".dbf", ".shx", ".prj", ".cpg" }) {
+			fs::path from = temp;
+			from.replace_extension(ext);
+			if (fs::exists(from)) {
+				fs::path to = path;
+				to.replace_extension(ext);
+				fs::rename(from, to);
+			}
+		}
+		fs::rename(temp, path);
+	}
+
+	template<class T>
+	static void writeRasterAtomically(const lapis::Raster<T>& data, const fs::path& path) {
+		fs::path temp = temporaryPath(path);
+		data.writeRaster(temp.string());
+		fs::rename(temp, path);
+	}
+
+	//a lock older than this is assumed to have been left by a process that died, and is broken
+	static constexpr auto staleDeriveLock = std::chrono::minutes(30);
+
+	void LidRFolder::_deriveSegmentProducts(size_t index) const {
+		fs::path lockPath = _derivedPath(index, "_derive.lock");
+		auto allExist = [&] {
+			return fs::exists(_derivedPath(index, "_highPoints.shp")) && fs::exists(_derivedPath(index, "_polygons.shp"))
+				&& fs::exists(_derivedPath(index, "_mhm.tif"));
+			};
+
+		//the lock file is created exclusively, so only one thread or process derives a tile at a time, and the rest wait for it
+		while (true) {
+			if (allExist()) {
+				return;
+			}
+			FILE* lock = std::fopen(lockPath.string().c_str(), "wx");
+			if (lock) {
+				std::fclose(lock);
+				break;
+			}
+			//only an existing lock is worth waiting on; a folder that can't be written to never will be
+			int openError = errno;
+			std::error_code ec;
+			if (openError != EEXIST && !fs::exists(lockPath, ec)) {
+				throw std::runtime_error("Unable to create " + lockPath.string() + ": " + std::strerror(openError));
+			}
+			auto lockTime = fs::last_write_time(lockPath, ec);
+			if (!ec && fs::file_time_type::clock::now() - lockTime > staleDeriveLock) {
+				fs::remove(lockPath, ec);
+				continue;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		}
+
+		try {
+			if (!allExist()) {
+				_writeSegmentProducts(index);
+			}
+		}
+		catch (...) {
+			std::error_code ec;
+			fs::remove(lockPath, ec);
+			throw;
+		}
+		std::error_code ec;
+		fs::remove(lockPath, ec);
+	}
+
+	void LidRFolder::materializeDerived() const {
+		std::function<bool(size_t)> derive = [&](size_t i) {
+			bool ok = true;
+			ok = highPoints(i).has_value() && ok;
+			ok = polygons(i).has_value() && ok;
+			ok = maxHeightRaster(i).has_value() && ok;
+			return ok;
+			};
+		size_t nFailed = 0;
+		std::function<void(size_t, bool&)> count = [&](size_t, bool& ok) {
+			if (!ok) {
+				++nFailed;
+			}
+			};
+		orderedParallelFor(nTiles(), derive, count);
+		if (nFailed) {
+			std::cerr << "Could not create the derived products of " << nFailed << " tiles.\n";
+		}
+	}
+
+	void LidRFolder::_writeSegmentProducts(size_t index) const {
+		fs::path highPointsPath = _derivedPath(index, "_highPoints.shp");
+		fs::path polygonsPath = _derivedPath(index, "_polygons.shp");
+		fs::path mhmPath = _derivedPath(index, "_mhm.tif");
+
+		auto basin = lapis::Raster<int>(stringOrThrow(watershedSegmentRaster(index)));
+		auto chm = lapis::Raster<lapis::csm_t>(stringOrThrow(csmRaster(index)));
+		auto tops = lapis::Raster<uint8_t>(stringOrThrow(topsRaster(index)));
+
+		//basin IDs are normally close to 1..n, so they map straight onto array slots; anything else goes through a hash map
+		int minId = std::numeric_limits<int>::max();
+		int maxId = std::numeric_limits<int>::min();
+		for (lapis::cell_t c = 0; c < basin.ncell(); ++c) {
+			if (basin[c].has_value()) {
+				minId = std::min(minId, basin[c].value());
+				maxId = std::max(maxId, basin[c].value());
+			}
+		}
+		bool dense = minId <= maxId && (int64_t)maxId - minId < 4 * (int64_t)basin.ncell() + 1024;
+		std::unordered_map<int, size_t> sparseSlot;
+
+		SegmentStats stats;
+		if (dense) {
+			size_t n = minId <= maxId ? (size_t)((int64_t)maxId - minId + 1) : 0;
+			stats.id.resize(n);
+			std::iota(stats.id.begin(), stats.id.end(), minId);
+		}
+		auto slotOf = [&](int id)->size_t {
+			if (dense) {
+				return (size_t)((int64_t)id - minId);
+			}
+			auto [it, added] = sparseSlot.try_emplace(id, stats.id.size());
+			if (added) {
+				stats.id.push_back(id);
+			}
+			return it->second;
+			};
+
+		std::vector<size_t> slot(basin.ncell(), noSegment);
+		for (lapis::cell_t c = 0; c < basin.ncell(); ++c) {
+			if (basin[c].has_value()) {
+				slot[c] = slotOf(basin[c].value());
+			}
+		}
+		size_t nSlot = stats.id.size();
+		stats.nCell.assign(nSlot, 0);
+		stats.topCell.assign(nSlot, -1);
+		stats.topHeight.assign(nSlot, std::numeric_limits<lapis::csm_t>::lowest());
+		stats.maxHeight.assign(nSlot, std::numeric_limits<lapis::csm_t>::lowest());
+
+		for (lapis::cell_t c = 0; c < basin.ncell(); ++c) {
+			if (slot[c] == noSegment) {
+				continue;
+			}
+			size_t s = slot[c];
+			++stats.nCell[s];
+			if (chm[c].has_value()) {
+				lapis::csm_t h = chm[c].value();
+				stats.maxHeight[s] = std::max(stats.maxHeight[s], h);
+				if (tops[c].has_value() && tops[c].value() && h > stats.topHeight[s]) {
+					stats.topCell[s] = c;
+					stats.topHeight[s] = h;
+				}
+			}
+		}
+
+		auto convarea = basin.xres() * basin.yres();
+
+		if (!fs::exists(highPointsPath)) {
+			lapis::VectorDataset<lapis::Point> out{};
+			out.addNumericField<lapis::coord_t>("X");
+			out.addNumericField<lapis::coord_t>("Y");
+			out.addNumericField<lapis::csm_t>("Height");
+			out.addNumericField<lapis::coord_t>("Area");
+			out.addNumericField<int>("ID");
+
+			//in ID order, so the output doesn't depend on whether the slots were dense
+			std::vector<size_t> order(nSlot);
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return stats.id[a] < stats.id[b]; });
+			for (size_t s : order) {
+				if (stats.topCell[s] < 0) {
+					continue;
+				}
+				lapis::Point pt{ tops.xFromCell(stats.topCell[s]), tops.yFromCell(stats.topCell[s]) };
+				out.addGeometry(pt);
+				out.back().setNumericField<lapis::coord_t>("X", pt.x());
+				out.back().setNumericField<lapis::coord_t>("Y", pt.y());
+				out.back().setNumericField<lapis::csm_t>("Height", stats.topHeight[s]);
+				out.back().setNumericField<lapis::coord_t>("Area", stats.nCell[s] * convarea);
+				out.back().setNumericField<int>("ID", stats.id[s]);
+			}
+			writeShapefileAtomically(out, highPointsPath);
+		}
+
+		if (!fs::exists(polygonsPath)) {
+			auto out = vectorizeBasins(basin);
+			out.addNumericField<lapis::coord_t>("X");
+			out.addNumericField<lapis::coord_t>("Y");
+			out.addNumericField<lapis::csm_t>("Height");
+			out.addNumericField<lapis::coord_t>("Area");
+			for (auto ft : out) {
+				size_t s = slotOf(ft.getNumericField<int>("ID"));
+				if (s >= nSlot) {
+					continue;
+				}
+				if (stats.topCell[s] >= 0) {
+					ft.setNumericField<lapis::coord_t>("X", tops.xFromCell(stats.topCell[s]));
+					ft.setNumericField<lapis::coord_t>("Y", tops.yFromCell(stats.topCell[s]));
+					ft.setNumericField<lapis::csm_t>("Height", stats.topHeight[s]);
+				}
+				ft.setNumericField<lapis::coord_t>("Area", stats.nCell[s] * convarea);
+			}
+			writeShapefileAtomically(out, polygonsPath);
+		}
+
+		if (!fs::exists(mhmPath)) {
+			auto out = chm;
+			for (lapis::cell_t c = 0; c < out.ncell(); ++c) {
+				if (slot[c] == noSegment) {
+					continue;
+				}
+				size_t s = slot[c];
+				lapis::csm_t h = stats.topCell[s] >= 0 ? stats.topHeight[s] : stats.maxHeight[s];
+				if (h == std::numeric_limits<lapis::csm_t>::lowest()) {
+					continue;
+				}
+				out[c].has_value() = true;
+				out[c].value() = h;
+			}
+			writeRasterAtomically(out, mhmPath);
+		}
+	}
+
+	TaoFieldResolver LidRFolder::_taoFields() const
+	{
+		return standardTaoFields;
+	}
+
+	TaoTable LidRFolder::_readTaoTable(size_t index, const fs::path& file) const
+	{
+		TaoTable out;
+		readTaoFile(file, standardTaoFields, (uint32_t)index, out);
+		return out;
+	}
+
+	std::vector<size_t> LidRFolder::_tilesOverlapping(const lapis::Extent& projE) const
+	{
+		return _tileIndex.overlapping(projE);
 	}
 
 	std::function<lapis::CoordXY(const lapis::ConstFeature<lapis::Point>&)> LidRFolder::coordGetter() const {
@@ -534,4 +739,18 @@ namespace processedfolder {
 			return ft.getNumericField<lapis::coord_t>("Area");
 			}; 
 	}
+
+	bool isLidRFolder(const fs::path& path)
+	{
+		if (!fs::is_directory(path)) {
+			return false;
+		}
+		if (!fs::exists(path / "Layout")) {
+			return false;
+		}
+		if (!fs::exists(path / "layout" / "layout.shp")) {
+			return false;
+		}
+		return true;
+	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #define LIDRFOLDER_H
 
 #include "ProcessedFolder.hpp"
+#include "TileIndex.hpp"
 
 
 namespace processedfolder {
@@ -37,17 +38,27 @@ namespace processedfolder {
 
 		std::optional<lapis::Extent> extentByTile(size_t index) const override;
 
-		lapis::VectorDataset<lapis::Point> allHighPoints() const override;
+		lapis::VectorDataset<lapis::Point> allHighPoints(GeometryMode mode = GeometryMode::full) const override;
 		std::optional<std::filesystem::path> highPoints(size_t index) const override;
-		lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e) const override;
+		lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const override;
 
-		lapis::VectorDataset<lapis::MultiPolygon> allPolygons() const override;
-		lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e) const override;
+		lapis::VectorDataset<lapis::MultiPolygon> allPolygons(GeometryMode mode = GeometryMode::full) const override;
+		lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const override;
 		std::optional<std::filesystem::path> polygons(size_t index) const override;
 
+		TileCursor<lapis::Point> highPointCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const override;
+		TileCursor<lapis::MultiPolygon> polygonCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const override;
+
 		std::optional<std::filesystem::path> topsRaster(size_t index) const;
 		std::optional<lapis::Raster<uint8_t>> topsRaster(const lapis::Extent& e) const;
 
+		std::optional<std::filesystem::path> tileFile(TileProduct product, size_t index) const override;
+
+		//Makes the high points, polygons, and max height model of every tile that doesn't have them yet, several tiles at a time
+		//These are otherwise made one tile at a time, the first time they're asked for
+		//Safe to run from several processes on the same folder at once; each tile is only made once
+		void materializeDerived() const;
+
 		std::optional<std::filesystem::path> watershedSegmentRaster(size_t index) const override;
 		std::optional<lapis::Raster<lapis::taoid_t>> watershedSegmentRaster(const lapis::Extent& e) const override;
 
@@ -60,6 +71,7 @@ namespace processedfolder {
 		std::optional<std::filesystem::path> csmRaster(size_t index) const override;
 		std::optional<lapis::Raster<lapis::csm_t>> csmRaster(const lapis::Extent& e) const override;
 
+
 		std::function<lapis::CoordXY(const lapis::ConstFeature<lapis::Point>&)> coordGetter() const override;
 		std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> heightGetter() const override;
 		std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> radiusGetter() const override;
@@ -68,10 +80,29 @@ namespace processedfolder {
 		std::filesystem::path _folder;
 		lapis::VectorDataset<lapis::MultiPolygon> _layout;
 		lapis::CoordRef _proj;
+		TileIndex _tileIndex;
 		std::string _name;
 		std::string _units;
+
+		//where the products derived from a tile's segment rasters are written
+		std::filesystem::path _derivedPath(size_t index, const std::string& suffix) const;
+		//makes any missing derived products of a tile, holding a lock file so no other thread or process does the same tile at once
+		//throws FileNotFoundException if one of the rasters is missing
+		void _deriveSegmentProducts(size_t index) const;
+		//reads the basin, CHM, and tops rasters of a tile once, and writes whichever of the high points, polygons, and max height model don't exist yet
+		void _writeSegmentProducts(size_t index) const;
+
+		TaoFieldResolver _taoFields() const override;
+		std::optional<lapis::Raster<float>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<float>& reader, const std::string& cacheName) const override;
+		std::optional<lapis::Raster<ScaledHeight>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<ScaledHeight>& reader, const std::string& cacheName) const override;
+		std::optional<VirtualMosaic<lapis::csm_t>> _heightMosaic(const lapis::Extent& e, TileProduct product, size_t maxBlocks) const override;
+		TaoTable _readTaoTable(size_t index, const std::filesystem::path& file) const override;
+		std::vector<size_t> _tilesOverlapping(const lapis::Extent& projE) const override;
 	};
 
+	//this checks for the presence of layout/layout.shp
+	bool isLidRFolder(const std::filesystem::path& path);
+
 }
 
 #endif
\ No newline at end of file
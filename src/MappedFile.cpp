@@ -0,0 +1,93 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+#ifdef _WIN32
+	MappedFile::MappedFile(const fs::path& file)
+	{
+		HANDLE handle = CreateFileW(file.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Unable to open " + file.string());
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+			CloseHandle(handle);
+			throw std::runtime_error("Unable to map " + file.string());
+		}
+		HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			CloseHandle(handle);
+			throw std::runtime_error("Unable to map " + file.string());
+		}
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view) {
+			CloseHandle(mapping);
+			CloseHandle(handle);
+			throw std::runtime_error("Unable to map " + file.string());
+		}
+		_file = handle;
+		_mapping = mapping;
+		_data = (const char*)view;
+		_size = (size_t)size.QuadPart;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		UnmapViewOfFile(_data);
+		CloseHandle(_mapping);
+		CloseHandle(_file);
+	}
+#else
+	MappedFile::MappedFile(const fs::path& file)
+	{
+		int fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Unable to open " + file.string());
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			throw std::runtime_error("Unable to map " + file.string());
+		}
+		void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		//the mapping keeps its own reference to the file
+		close(fd);
+		if (view == MAP_FAILED) {
+			throw std::runtime_error("Unable to map " + file.string());
+		}
+		_data = (const char*)view;
+		_size = (size_t)st.st_size;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		munmap((void*)_data, _size);
+	}
+#endif
+
+	const char* MappedFile::data() const
+	{
+		return _data;
+	}
+
+	size_t MappedFile::size() const
+	{
+		return _size;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//A read-only memory map of a whole file
+	class MappedFile {
+	public:
+		//throws std::runtime_error if the file can't be mapped
+		MappedFile(const std::filesystem::path& file);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* data() const;
+		size_t size() const;
+
+	private:
+		const char* _data = nullptr;
+		size_t _size = 0;
+#ifdef _WIN32
+		void* _file = nullptr;
+		void* _mapping = nullptr;
+#endif
+	};
+}
+
+#endif
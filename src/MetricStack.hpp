@@ -0,0 +1,30 @@
+#pragma once
+#ifndef METRICSTACK_H
+#define METRICSTACK_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//Several metric rasters read onto one grid, stored one whole layer after another
+	//This lets a model run over every cell in a single vectorized pass instead of juggling one raster per metric
+	struct MetricStack {
+		lapis::Alignment alignment;
+		size_t nLayer = 0;
+
+		//the value of layer l at cell c is values[l * alignment.ncell() + c]
+		//cells that aren't valid are set to 0 in every layer
+		std::vector<float> values;
+
+		//1 for cells where every layer has a value, 0 otherwise
+		std::vector<uint8_t> valid;
+
+		float* layer(size_t l) {
+			return values.data() + l * (size_t)alignment.ncell();
+		}
+		const float* layer(size_t l) const {
+			return values.data() + l * (size_t)alignment.ncell();
+		}
+	};
+}
+
+#endif
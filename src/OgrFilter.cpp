@@ -0,0 +1,64 @@
+#include "OgrFilter.hpp"
+#include "ProcessedFolder.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	std::string insideWhere(const std::string& xField, const std::string& yField, const lapis::Extent& e)
+	{
+		std::ostringstream out;
+		out << std::setprecision(17);
+		out << "\"" << xField << "\" >= " << e.xmin() << " AND \"" << xField << "\" <= " << e.xmax()
+			<< " AND \"" << yField << "\" >= " << e.ymin() << " AND \"" << yField << "\" <= " << e.ymax();
+		return out.str();
+	}
+
+	std::string filteredCopy(const fs::path& file, const OgrFilter& filter)
+	{
+		static std::atomic<uint64_t> counter{ 0 };
+
+		lapis::UniqueGdalDataset src = lapis::vectorGDALWrapper(file.string());
+		OGRLayer* layer = src->GetLayer(0);
+		if (filter.geometry == GeometryMode::none) {
+			if (filter.rect) {
+				throw std::invalid_argument("A spatial filter needs the geometry to be read");
+			}
+			const char* ignored[] = { "OGR_GEOMETRY", nullptr };
+			layer->SetIgnoredFields(ignored);
+		}
+		if (filter.rect) {
+			const lapis::Extent& r = filter.rect.value();
+			layer->SetSpatialFilterRect(r.xmin(), r.ymin(), r.xmax(), r.ymax());
+		}
+		if (filter.where) {
+			OGRFeatureDefn* defn = layer->GetLayerDefn();
+			std::vector<std::string> fieldNames;
+			for (int i = 0; i < defn->GetFieldCount(); ++i) {
+				fieldNames.push_back(defn->GetFieldDefn(i)->GetNameRef());
+			}
+			std::string where = filter.where(fieldNames);
+			if (where.size() && layer->SetAttributeFilter(where.c_str()) != OGRERR_NONE) {
+				throw FileNotFoundException("Unable to filter " + file.string() + " by " + where);
+			}
+		}
+
+		std::string copy = "/vsimem/processedfolder_filtered_" + std::to_string(counter++) + ".shp";
+		GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("ESRI Shapefile");
+		GDALDataset* dst = driver->Create(copy.c_str(), 0, 0, 0, GDT_Unknown, nullptr);
+		if (!dst) {
+			throw FileNotFoundException("Unable to create " + copy);
+		}
+		OGRLayer* copied = dst->CopyLayer(layer, layer->GetName());
+		GDALClose(dst);
+		if (!copied) {
+			removeFilteredCopy(copy);
+			throw FileNotFoundException("Unable to read " + file.string());
+		}
+		return copy;
+	}
+
+	void removeFilteredCopy(const std::string& copy)
+	{
+		GetGDALDriverManager()->GetDriverByName("ESRI Shapefile")->Delete(copy.c_str());
+	}
+}
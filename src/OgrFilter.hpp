@@ -0,0 +1,88 @@
+#pragma once
+#ifndef OGRFILTER_H
+#define OGRFILTER_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//Whether vector reads decode geometry
+	//With none, getGeometry() mustn't be called on the features. Filtered reads then carry only the attributes, which is much smaller and faster for polygons
+	enum class GeometryMode {
+		full,
+		none
+	};
+
+	//Filters that OGR applies while reading a vector file, so features that fail them are never turned into lapis features
+	struct OgrFilter {
+		//features whose geometry doesn't touch this rectangle are skipped. It's in the projection of the file
+		//this needs the geometry, so it can't be combined with GeometryMode::none
+		std::optional<lapis::Extent> rect;
+
+		//builds an OGR SQL where clause from the field names of the file. An empty clause keeps every feature
+		std::function<std::string(const std::vector<std::string>&)> where;
+
+		GeometryMode geometry = GeometryMode::full;
+	};
+
+	//A where clause keeping the features whose xField and yField values lie inside e, edges included, as Extent::contains does
+	std::string insideWhere(const std::string& xField, const std::string& yField, const lapis::Extent& e);
+
+	//Copies the features of file that pass filter into an in-memory shapefile, and returns its path
+	//The copy has to be removed with removeFilteredCopy
+	std::string filteredCopy(const std::filesystem::path& file, const OgrFilter& filter);
+	void removeFilteredCopy(const std::string& copy);
+
+	//Reads only the features of file that pass filter
+	//The filtered features are re-encoded through filteredCopy, so that's skipped when there's no rect or where and nothing would be filtered out
+	//The file is then read as it is, geometry included even with GeometryMode::none, since re-encoding it costs more than decoding the geometry
+	template<class T>
+	lapis::VectorDataset<T> readFiltered(const std::filesystem::path& file, const OgrFilter& filter) {
+		if (!filter.rect && !filter.where) {
+			return lapis::VectorDataset<T>(file.string());
+		}
+		std::string copy = filteredCopy(file, filter);
+		try {
+			lapis::VectorDataset<T> out{ copy };
+			removeFilteredCopy(copy);
+			return out;
+		}
+		catch (...) {
+			removeFilteredCopy(copy);
+			throw;
+		}
+	}
+
+	//Adds the features of tile to out
+	//The first tile becomes out, even with no features, so out takes on the file's schema; outInit records whether that has happened
+	template<class T>
+	void mergeInto(lapis::VectorDataset<T>& out, bool& outInit, lapis::VectorDataset<T>& tile) {
+		if (!outInit) {
+			out = std::move(tile);
+			outInit = true;
+			return;
+		}
+		for (lapis::ConstFeature<T> ft : tile) {
+			out.addFeature(ft);
+		}
+	}
+
+	//Adds the features of file that pass filter to out, holding no more than that one file's worth of extra features at a time
+	template<class T>
+	void appendFiltered(lapis::VectorDataset<T>& out, bool& outInit, const std::filesystem::path& file, const OgrFilter& filter) {
+		lapis::VectorDataset<T> tile = readFiltered<T>(file, filter);
+		mergeInto(out, outInit, tile);
+	}
+
+	//Reads every file into one dataset, in order, through filter
+	template<class T>
+	lapis::VectorDataset<T> readAllFiltered(const std::vector<std::filesystem::path>& files, const OgrFilter& filter) {
+		lapis::VectorDataset<T> out{};
+		bool outInit = false;
+		for (const std::filesystem::path& file : files) {
+			appendFiltered(out, outInit, file, filter);
+		}
+		return out;
+	}
+}
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef PROCESSEDFOLDER_PARALLEL_H
+#define PROCESSEDFOLDER_PARALLEL_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	inline std::atomic<int>& _maxReadThreadsSetting() {
+		static std::atomic<int> n{ 0 };
+		return n;
+	}
+
+	//The number of threads used when reading many tiles at once. 0, the default, means one per core
+	inline void setMaxReadThreads(int n) {
+		_maxReadThreadsSetting() = n;
+	}
+	inline int maxReadThreads() {
+		int n = _maxReadThreadsSetting();
+		if (n <= 0) {
+			n = (int)std::thread::hardware_concurrency();
+		}
+		return std::max(n, 1);
+	}
+
+	inline bool& _onWorkerThread() {
+		static thread_local bool flag = false;
+		return flag;
+	}
+
+	//Marks the current thread as one of this library's worker threads while it exists
+	//Work done on a worker thread doesn't start threads of its own, so nested parallel work can't multiply the thread count
+	class WorkerThreadScope {
+	public:
+		WorkerThreadScope() : _was(_onWorkerThread()) {
+			_onWorkerThread() = true;
+		}
+		~WorkerThreadScope() {
+			_onWorkerThread() = _was;
+		}
+		WorkerThreadScope(const WorkerThreadScope&) = delete;
+		WorkerThreadScope& operator=(const WorkerThreadScope&) = delete;
+
+	private:
+		bool _was;
+	};
+
+	//The number of threads work started from this thread may use: maxReadThreads(), or 1 on a worker thread
+	inline int availableThreads() {
+		return _onWorkerThread() ? 1 : maxReadThreads();
+	}
+
+	//Runs produce(i) for every i in [0,n) on up to nThread threads, and calls consume(i, result) on the calling thread in order of i
+	//At most nThread results are held at once, so memory stays bounded no matter how large n is
+	//An exception thrown by produce is rethrown from here once the in-flight work has finished
+	//produce runs under a WorkerThreadScope, so anything it calls stays on its thread
+	template<class T>
+	void orderedParallelFor(size_t n, const std::function<T(size_t)>& produce, const std::function<void(size_t, T&)>& consume, int nThread = availableThreads()) {
+		if (nThread <= 1) {
+			for (size_t i = 0; i < n; ++i) {
+				T result = produce(i);
+				consume(i, result);
+			}
+			return;
+		}
+
+		auto onWorker = [&produce](size_t i) {
+			WorkerThreadScope scope;
+			return produce(i);
+			};
+		std::deque<std::future<T>> inFlight;
+		size_t next = 0;
+		for (size_t i = 0; i < n; ++i) {
+			while (next < n && inFlight.size() < (size_t)nThread) {
+				inFlight.push_back(std::async(std::launch::async, onWorker, next));
+				++next;
+			}
+			T result = inFlight.front().get();
+			inFlight.pop_front();
+			consume(i, result);
+		}
+	}
+}
+
+#endif
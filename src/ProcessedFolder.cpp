@@ -0,0 +1,275 @@
+#include "ProcessedFolder.hpp"
+#include "Parallel.hpp"
+#include "TileMosaic.hpp"
+#include "VrtExport.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	ScaledHeight scaleHeight(lapis::csm_t height)
+	{
+		lapis::csm_t scaled = std::round(height * 100);
+		return (ScaledHeight)std::clamp<lapis::csm_t>(scaled, 0, std::numeric_limits<ScaledHeight>::max());
+	}
+
+	lapis::csm_t unscaleHeight(ScaledHeight height)
+	{
+		return (lapis::csm_t)height / 100;
+	}
+
+	static lapis::Raster<ScaledHeight> readScaledHeights(const fs::path& file, const std::optional<lapis::Extent>& e) {
+		lapis::Raster<float> heights = e ? lapis::Raster<float>{ file.string(), e.value(), lapis::SnapType::out } : lapis::Raster<float>{ file.string() };
+		lapis::Raster<ScaledHeight> out{ (const lapis::Alignment&)heights };
+		for (lapis::cell_t c = 0; c < heights.ncell(); ++c) {
+			if (heights[c].has_value()) {
+				out[c].has_value() = true;
+				out[c].value() = scaleHeight(heights[c].value());
+			}
+		}
+		return out;
+	}
+
+	std::optional<lapis::Raster<float>> ProcessedFolder::maxHeightRasterFloat(const lapis::Extent& e) const
+	{
+		return _reducedHeightMosaic(e, TileProduct::maxHeight, TileReader<float>(), "maxHeightFloat");
+	}
+
+	std::optional<lapis::Raster<ScaledHeight>> ProcessedFolder::maxHeightRasterScaled(const lapis::Extent& e) const
+	{
+		return _reducedHeightMosaic(e, TileProduct::maxHeight, TileReader<ScaledHeight>(readScaledHeights), "maxHeightScaled");
+	}
+
+	std::optional<lapis::Raster<float>> ProcessedFolder::csmRasterFloat(const lapis::Extent& e) const
+	{
+		return _reducedHeightMosaic(e, TileProduct::csm, TileReader<float>(), "csmFloat");
+	}
+
+	std::optional<lapis::Raster<ScaledHeight>> ProcessedFolder::csmRasterScaled(const lapis::Extent& e) const
+	{
+		return _reducedHeightMosaic(e, TileProduct::csm, TileReader<ScaledHeight>(readScaledHeights), "csmScaled");
+	}
+
+	std::optional<VirtualMosaic<lapis::csm_t>> ProcessedFolder::maxHeightMosaic(const lapis::Extent& e, size_t maxBlocks) const
+	{
+		return _heightMosaic(e, TileProduct::maxHeight, maxBlocks);
+	}
+
+	std::optional<VirtualMosaic<lapis::csm_t>> ProcessedFolder::csmMosaic(const lapis::Extent& e, size_t maxBlocks) const
+	{
+		return _heightMosaic(e, TileProduct::csm, maxBlocks);
+	}
+
+	std::optional<fs::path> ProcessedFolder::tileFile(TileProduct product, size_t index) const
+	{
+		switch (product) {
+		case TileProduct::csm:
+			return csmRaster(index);
+		case TileProduct::maxHeight:
+			return maxHeightRaster(index);
+		case TileProduct::intensity:
+			return intensityRaster(index);
+		case TileProduct::segments:
+			return watershedSegmentRaster(index);
+		default:
+			return std::nullopt;
+		}
+	}
+
+	bool ProcessedFolder::writeVrt(TileProduct product, const fs::path& vrt) const
+	{
+		std::vector<fs::path> files;
+		for (size_t i = 0; i < nTiles(); ++i) {
+			std::optional<fs::path> file = tileFile(product, i);
+			if (file) {
+				files.push_back(file.value());
+			}
+		}
+		//FUSION's extent queries draw each tile over the ones before it, while the others keep the first tile's value
+		TilePrecedence precedence = type() == RunType::fusion ? TilePrecedence::lastWins : TilePrecedence::firstWins;
+		return writeTileVrt(vrt, crs(), files, csmAlignment(), precedence);
+	}
+
+	MetricStack ProcessedFolder::metricStack(const std::vector<std::optional<fs::path>>& metrics, const lapis::Extent& e) const
+	{
+		std::vector<fs::path> paths;
+		for (const std::optional<fs::path>& metric : metrics) {
+			paths.push_back(stringOrThrow(metric));
+		}
+		std::optional<lapis::Alignment> fullAlignment = metricAlignment();
+		if (!fullAlignment) {
+			throw FileNotFoundException("No metric alignment in " + dir().string());
+		}
+		fullAlignment->defineCRS(crs());
+
+		MetricStack out;
+		out.nLayer = paths.size();
+		lapis::Extent projE = lapis::QuadExtent(e, fullAlignment->crs()).outerExtent();
+		if (!projE.overlaps(fullAlignment.value())) {
+			return out;
+		}
+		out.alignment = cropAlignment(fullAlignment.value(), projE, lapis::SnapType::out);
+
+		size_t ncell = (size_t)out.alignment.ncell();
+		out.values.assign(out.nLayer * ncell, 0.f);
+		out.valid.assign(ncell, 1);
+
+		std::function<std::optional<lapis::Raster<float>>(size_t)> read = [&](size_t l)->std::optional<lapis::Raster<float>> {
+			try {
+				lapis::Raster<float> r{ paths[l].string(), out.alignment, lapis::SnapType::out };
+				r.defineCRS(out.alignment.crs());
+				return r;
+			}
+			catch (lapis::LapisGisException e) {
+				//a metric that's there but unreadable would otherwise blank every cell of the stack
+				throw FileNotFoundException("Unable to read " + paths[l].string());
+			}
+			};
+		std::function<void(size_t, std::optional<lapis::Raster<float>>&)> place = [&](size_t l, std::optional<lapis::Raster<float>>& r) {
+			std::vector<uint8_t> has(ncell, 0);
+			if (r) {
+				float* layer = out.layer(l);
+				for (lapis::cell_t c = 0; c < r->ncell(); ++c) {
+					lapis::coord_t x = r->xFromCell(c);
+					lapis::coord_t y = r->yFromCell(c);
+					if (!out.alignment.contains(x, y) || !r->atCellUnsafe(c).has_value()) {
+						continue;
+					}
+					size_t outCell = (size_t)out.alignment.cellFromXYUnsafe(x, y);
+					layer[outCell] = r->atCellUnsafe(c).value();
+					has[outCell] = 1;
+				}
+			}
+			for (size_t c = 0; c < ncell; ++c) {
+				out.valid[c] &= has[c];
+			}
+			};
+		orderedParallelFor(paths.size(), read, place);
+
+		for (size_t l = 0; l < out.nLayer; ++l) {
+			float* layer = out.layer(l);
+			for (size_t c = 0; c < ncell; ++c) {
+				if (!out.valid[c]) {
+					layer[c] = 0.f;
+				}
+			}
+		}
+		return out;
+	}
+
+	//path lookups can derive files in some run types, so they're done here, on the calling thread, and only the parsing is spread over threads
+	static std::vector<std::pair<size_t, fs::path>> taoFiles(const ProcessedFolder& folder, const std::vector<size_t>& tiles) {
+		std::vector<std::pair<size_t, fs::path>> out;
+		for (size_t tile : tiles) {
+			std::optional<fs::path> file = folder.highPoints(tile);
+			if (file) {
+				out.emplace_back(tile, file.value());
+			}
+		}
+		return out;
+	}
+
+	TaoTable ProcessedFolder::taoTable(size_t index) const
+	{
+		std::optional<fs::path> file = highPoints(index);
+		if (!file) {
+			return TaoTable();
+		}
+		return _readTaoTable(index, file.value());
+	}
+
+	TaoTable ProcessedFolder::taoTable(const lapis::Extent& e) const
+	{
+		TaoTable out;
+		lapis::Extent projE = lapis::QuadExtent(e, crs()).outerExtent();
+
+		std::vector<std::pair<size_t, fs::path>> files = taoFiles(*this, _tilesOverlapping(projE));
+		std::function<TaoTable(size_t)> read = [&](size_t i) { return _readTaoTable(files[i].first, files[i].second); };
+		std::function<void(size_t, TaoTable&)> filter = [&](size_t, TaoTable& tile) {
+			for (size_t i = 0; i < tile.size(); ++i) {
+				if (projE.contains(tile.x[i], tile.y[i])) {
+					out.push_back(tile.x[i], tile.y[i], tile.height[i], tile.area[i], tile.id[i], tile.tile[i]);
+				}
+			}
+			};
+		orderedParallelFor(files.size(), read, filter);
+		return out;
+	}
+
+	TaoTable ProcessedFolder::allTaoTable() const
+	{
+		TaoTable out;
+		std::vector<size_t> tiles(nTiles());
+		std::iota(tiles.begin(), tiles.end(), (size_t)0);
+		std::vector<std::pair<size_t, fs::path>> files = taoFiles(*this, tiles);
+		std::function<TaoTable(size_t)> read = [&](size_t i) { return _readTaoTable(files[i].first, files[i].second); };
+		std::function<void(size_t, TaoTable&)> append = [&](size_t, TaoTable& tile) { out.append(tile); };
+		orderedParallelFor(files.size(), read, append);
+		return out;
+	}
+
+	TaoIndex ProcessedFolder::taoIndex(size_t index) const
+	{
+		std::optional<fs::path> file = highPoints(index);
+		if (!file) {
+			return TaoIndex();
+		}
+		fs::path indexFile = file.value();
+		indexFile += ".taoidx";
+
+		//taken before reading, so if the TAO file changes partway through, the saved index is already stale
+		TaoSourceStamp stamp = taoSourceStamp(file.value());
+		std::optional<TaoIndex> saved = TaoIndex::load(indexFile, stamp);
+		if (saved) {
+			return std::move(saved.value());
+		}
+		TaoIndex out{ taoTable(index) };
+		out.save(indexFile, stamp);
+		return out;
+	}
+
+	TaoIndex ProcessedFolder::taoIndex(const lapis::Extent& e) const
+	{
+		return TaoIndex(taoTable(e));
+	}
+
+	std::shared_ptr<const TaoIdLookup> ProcessedFolder::taoIdLookup(size_t index) const
+	{
+		{
+			std::lock_guard lock{ _taoIdLookups->mut };
+			auto found = _taoIdLookups->byTile.find(index);
+			if (found != _taoIdLookups->byTile.end()) {
+				return found->second;
+			}
+		}
+
+		//built outside the lock so other tiles aren't held up; if two threads race, the first one stored wins
+		TaoTable table;
+		std::optional<fs::path> file = highPoints(index);
+		if (file && !readTaoFile(file.value(), _taoFields(), (uint32_t)index, table)) {
+			//otherwise every lookup would quietly find nothing
+			throw FileNotFoundException("No ID field in " + file.value().string());
+		}
+		auto lookup = std::make_shared<const TaoIdLookup>(std::move(table));
+
+		std::lock_guard lock{ _taoIdLookups->mut };
+		return _taoIdLookups->byTile.try_emplace(index, lookup).first->second;
+	}
+
+	void ProcessedFolder::setTileCacheSize(size_t maxBytes)
+	{
+		if (!maxBytes) {
+			_tileCache.reset();
+		}
+		else if (_tileCache) {
+			_tileCache->setMaxBytes(maxBytes);
+		}
+		else {
+			_tileCache = std::make_shared<TileCache>(maxBytes);
+		}
+	}
+
+	std::shared_ptr<TileCache> ProcessedFolder::tileCache() const
+	{
+		return _tileCache;
+	}
+}
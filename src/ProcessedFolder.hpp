@@ -3,6 +3,16 @@
 #define PROCESSEDFOLDER_H
 
 #include "ProcessedFolder_pch.hpp"
+#include "TileCache.hpp"
+#include "MetricStack.hpp"
+#include "TaoTable.hpp"
+#include "TaoIndex.hpp"
+#include "TaoIdLookup.hpp"
+#include "OgrFilter.hpp"
+#include "TileCursor.hpp"
+#include "TileMosaic.hpp"
+#include "VirtualMosaic.hpp"
+#include "TilePipeline.hpp"
 
 namespace processedfolder {
 	
@@ -21,6 +31,21 @@ namespace processedfolder {
 		}
 	}
 
+	//A height stored as hundredths of the run's units, so centimetres for metric runs
+	using ScaledHeight = uint16_t;
+	//Rounds to the nearest hundredth, clamping to the range of ScaledHeight
+	ScaledHeight scaleHeight(lapis::csm_t height);
+	lapis::csm_t unscaleHeight(ScaledHeight height);
+
+	//The per-tile rasters of a run
+	enum class TileProduct {
+		csm,
+		maxHeight,
+		intensity,
+		segments,
+		tops //lidR runs only
+	};
+
 	enum RunType {
 		lapis,
 		fusion,
@@ -57,14 +82,20 @@ namespace processedfolder {
 
 		virtual std::optional<lapis::Extent> extentByTile(size_t index) const = 0;
 
-		virtual lapis::VectorDataset<lapis::Point> allHighPoints() const = 0;
-		virtual lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e) const = 0;
+		//With GeometryMode::none, the features are read with their attributes only, for analyses that just need X, Y, Height, and Area
+		virtual lapis::VectorDataset<lapis::Point> allHighPoints(GeometryMode mode = GeometryMode::full) const = 0;
+		virtual lapis::VectorDataset<lapis::Point> highPoints(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const = 0;
 		virtual std::optional<std::filesystem::path> highPoints(size_t index) const = 0;
 
-		virtual lapis::VectorDataset<lapis::MultiPolygon> allPolygons() const = 0;
-		virtual lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e) const = 0;
+		virtual lapis::VectorDataset<lapis::MultiPolygon> allPolygons(GeometryMode mode = GeometryMode::full) const = 0;
+		virtual lapis::VectorDataset<lapis::MultiPolygon> polygons(const lapis::Extent& e, GeometryMode mode = GeometryMode::full) const = 0;
 		virtual std::optional<std::filesystem::path> polygons(size_t index) const = 0;
 
+		//The same features as allHighPoints() and allPolygons(), but read one tile at a time so memory use doesn't grow with the size of the run
+		//The cursor reads through this folder, so it must not outlive it
+		virtual TileCursor<lapis::Point> highPointCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const = 0;
+		virtual TileCursor<lapis::MultiPolygon> polygonCursor(bool readAhead = true, GeometryMode mode = GeometryMode::full) const = 0;
+
 		virtual std::optional<std::filesystem::path> watershedSegmentRaster(size_t index) const = 0;
 		virtual std::optional<lapis::Raster<lapis::taoid_t>> watershedSegmentRaster(const lapis::Extent& e) const = 0;
 
@@ -77,12 +108,90 @@ namespace processedfolder {
 		virtual std::optional<std::filesystem::path> csmRaster(size_t index) const = 0;
 		virtual std::optional<lapis::Raster<lapis::csm_t>> csmRaster(const lapis::Extent& e) const = 0;
 
+		//The same mosaics as maxHeightRaster(e) and csmRaster(e), at 4 or 2 bytes per cell instead of 8
+		//The tile cache keeps these separately from the full precision tiles
+		std::optional<lapis::Raster<float>> maxHeightRasterFloat(const lapis::Extent& e) const;
+		std::optional<lapis::Raster<ScaledHeight>> maxHeightRasterScaled(const lapis::Extent& e) const;
+		std::optional<lapis::Raster<float>> csmRasterFloat(const lapis::Extent& e) const;
+		std::optional<lapis::Raster<ScaledHeight>> csmRasterScaled(const lapis::Extent& e) const;
+
+		//Views of the max height and csm mosaics over e that only read the blocks of cells that are looked at
+		//They have the same grid, tiles, and overlap rule as maxHeightRaster(e) and csmRaster(e)
+		//Opening one only reads the header of one tile, so e can be as large as the run. nullopt if no tile under e can be read
+		//The mosaic keeps a raw pointer to this folder and looks tile files up through it, so it must not outlive the folder
+		std::optional<VirtualMosaic<lapis::csm_t>> maxHeightMosaic(const lapis::Extent& e, size_t maxBlocks = 64) const;
+		std::optional<VirtualMosaic<lapis::csm_t>> csmMosaic(const lapis::Extent& e, size_t maxBlocks = 64) const;
+
+		//The file of one tile of a product, the same as calling csmRaster(index) and so on. nullopt for products this run type doesn't have
+		virtual std::optional<std::filesystem::path> tileFile(TileProduct product, size_t index) const;
+
+		//Writes a GDAL VRT over every tile of the product, with the CRS of this run and the tiles' resolutions repaired onto csmAlignment(), as in writeTileVrt
+		//Overlapping tiles are resolved the same way as in this run type's extent queries
+		//Returns false if there are no readable tiles or the file couldn't be written
+		bool writeVrt(TileProduct product, const std::filesystem::path& vrt) const;
+
+		//Calls fn(tile, raster) for every tile of the product, with the upcoming tiles read and decoded while fn works, as in forEachTileFile
+		//fn runs on several threads at once and may see tiles out of order
+		template<class T>
+		void forEachTile(TileProduct product, const std::function<void(size_t, const lapis::Raster<T>&)>& fn,
+			const TilePipelineOptions& options = TilePipelineOptions()) const {
+			forEachTileFile<T>(nTiles(), crs(), [&](size_t i) { return tileFile(product, i); }, fn, options);
+		}
+
+		//The TAOs as columns, with the field names resolved once per file. Much faster than the getters below for bulk work
+		//The per-tile version only includes TAOs owned by that tile, so concatenating tiles never double counts
+		TaoTable taoTable(size_t index) const;
+		TaoTable taoTable(const lapis::Extent& e) const;
+		TaoTable allTaoTable() const;
+
+		//A spatial index over the TAOs of one tile, for radius, nearest-neighbour, and box queries
+		//It's saved next to the tile's TAO file, as .taoidx, and reused until that file changes
+		TaoIndex taoIndex(size_t index) const;
+		//An index over the TAOs in e, built in memory from taoTable(e)
+		TaoIndex taoIndex(const lapis::Extent& e) const;
+
+		//Finds the TAOs of one tile by the IDs in watershedSegmentRaster(index)
+		//Unlike taoTable(index), this includes the TAOs in the tile's buffer, since its segment raster covers the buffer too
+		//Built the first time it's asked for, and kept until the folder is destroyed or refreshed
+		//Throws FileNotFoundException if the tile's TAO file has no ID field
+		std::shared_ptr<const TaoIdLookup> taoIdLookup(size_t index) const;
+
 		virtual std::function<lapis::CoordXY(const lapis::ConstFeature<lapis::Point>&)> coordGetter() const = 0;
 		virtual std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> heightGetter() const = 0;
 		virtual std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> radiusGetter() const = 0;
 		virtual std::function<lapis::coord_t(const lapis::ConstFeature<lapis::Point>&)> areaGetter() const = 0;
 
+		//Reads several metrics, such as {p95(), cover(), meanHeight()}, onto metricAlignment() cropped to e
+		//The rasters are read concurrently, and cells are only valid where every metric has a value
+		//Throws FileNotFoundException if any of the metrics is missing or can't be read
+		MetricStack metricStack(const std::vector<std::optional<std::filesystem::path>>& metrics, const lapis::Extent& e) const;
+
+		//Keeps decoded tiles in memory between extent queries, up to maxBytes in total. 0 turns the cache off
+		void setTileCacheSize(size_t maxBytes);
+		//nullptr if the cache is off
+		std::shared_ptr<TileCache> tileCache() const;
+
 		virtual ~ProcessedFolder() = default;
+
+	protected:
+		std::shared_ptr<TileCache> _tileCache;
+		std::shared_ptr<TaoIdLookupCache> _taoIdLookups = std::make_shared<TaoIdLookupCache>();
+
+		//how to find the TAO attributes in this run's TAO files
+		virtual TaoFieldResolver _taoFields() const = 0;
+
+		//the run type's own extent query over a product's tiles, with each tile decoded by reader, or read directly if it's null
+		//the reduced-precision mosaics go through this, so tiles are chosen and combined exactly as in csmRaster(e) and maxHeightRaster(e)
+		virtual std::optional<lapis::Raster<float>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<float>& reader, const std::string& cacheName) const = 0;
+		virtual std::optional<lapis::Raster<ScaledHeight>> _reducedHeightMosaic(const lapis::Extent& e, TileProduct product, const TileReader<ScaledHeight>& reader, const std::string& cacheName) const = 0;
+		//parses one tile's TAO file, keeping only the TAOs that tile owns
+		//this doesn't look anything up, so unlike highPoints(index) it's safe to call from worker threads
+		virtual TaoTable _readTaoTable(size_t index, const std::filesystem::path& file) const = 0;
+		//the tiles whose layout extents overlap projE, which is in crs(), chosen the same way as in the run type's extent queries
+		virtual std::vector<size_t> _tilesOverlapping(const lapis::Extent& projE) const = 0;
+
+		//the virtual counterpart of the run type's extent query, with the same tile selection and overlap rule
+		virtual std::optional<VirtualMosaic<lapis::csm_t>> _heightMosaic(const lapis::Extent& e, TileProduct product, size_t maxBlocks) const = 0;
 	};
 } //namespace processedfolder
 
@@ -0,0 +1,310 @@
+#include "ProcessedFolderCatalog.hpp"
+#include "ReadProcessedFolder.hpp"
+#include "Parallel.hpp"
+#include "TempFile.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	static const std::string catalogCacheHeader = "ProcessedFolderCatalog 2";
+
+	static void hashCombine(uint64_t& hash, uint64_t value) {
+		//FNV-1a over the bytes of value
+		for (int i = 0; i < 8; ++i) {
+			hash ^= (value >> (8 * i)) & 0xff;
+			hash *= 1099511628211ull;
+		}
+	}
+
+	static void hashCombine(uint64_t& hash, const std::string& value) {
+		for (unsigned char c : value) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+	}
+
+	//Adding or removing a file only changes the modification time of the directory it's in, so this covers a directory and the folders directly inside it
+	//The directory holding the cache file leaves out its own time, since writing the cache changes it
+	static void directoryStamp(uint64_t& hash, const fs::path& dir, bool includeOwnTime) {
+		std::error_code ec;
+		hashCombine(hash, dir.generic_string());
+		if (includeOwnTime) {
+			hashCombine(hash, (uint64_t)fs::last_write_time(dir, ec).time_since_epoch().count());
+		}
+		std::vector<std::pair<std::string, uint64_t>> subdirs;
+		for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec)) {
+			if (entry.is_directory(ec)) {
+				subdirs.emplace_back(entry.path().filename().string(), (uint64_t)entry.last_write_time(ec).time_since_epoch().count());
+			}
+		}
+		std::sort(subdirs.begin(), subdirs.end());
+		for (const auto& subdir : subdirs) {
+			hashCombine(hash, subdir.first);
+			hashCombine(hash, subdir.second);
+		}
+	}
+
+	static uint64_t runStamp(const std::vector<fs::path>& watched, const fs::path& cacheDir) {
+		uint64_t hash = 14695981039346656037ull;
+		for (const fs::path& dir : watched) {
+			std::error_code ec;
+			directoryStamp(hash, dir, !fs::equivalent(dir, cacheDir, ec));
+		}
+		return hash;
+	}
+
+	//The directories a run's metadata is read from: the folder it was found in, the root it resolved to, which for FUSION can be nested a few levels down,
+	//and the folder holding its tile layout
+	static std::vector<fs::path> watchedDirectories(const fs::path& dir, const ProcessedFolder& folder) {
+		std::vector<fs::path> out = { dir, folder.dir() };
+		std::optional<fs::path> layout = folder.tileLayoutVector();
+		if (layout) {
+			out.push_back(layout->parent_path());
+		}
+		std::vector<fs::path> unique;
+		for (const fs::path& candidate : out) {
+			std::error_code ec;
+			bool seen = std::any_of(unique.begin(), unique.end(), [&](const fs::path& p) { return fs::equivalent(p, candidate, ec); });
+			if (!seen) {
+				unique.push_back(candidate);
+			}
+		}
+		return unique;
+	}
+
+	static std::string singleLine(std::string s) {
+		std::replace(s.begin(), s.end(), '\n', ' ');
+		std::replace(s.begin(), s.end(), '\r', ' ');
+		return s;
+	}
+
+	//Opened the same way as readProcessedFolder, so a run it can open is never left out, and the type recorded is the one that opened
+	static std::optional<CatalogEntry> describeRun(const fs::path& dir, const fs::path& cacheDir) {
+		std::unique_ptr<ProcessedFolder> folder = readProcessedFolder(dir.string());
+		if (!folder) {
+			return std::nullopt;
+		}
+
+		CatalogEntry out;
+		out.dir = dir;
+		out.type = folder->type();
+		out.crs = folder->crs();
+		out.extent = folder->extent();
+		out.nTiles = folder->nTiles();
+		for (size_t i = 0; i < out.nTiles; ++i) {
+			out.tileExtents.push_back(folder->extentByTile(i));
+		}
+		out.watched = watchedDirectories(dir, *folder);
+		out.stamp = runStamp(out.watched, cacheDir);
+		return out;
+	}
+
+	ProcessedFolderCatalog::ProcessedFolderCatalog(const fs::path& root, const std::optional<fs::path>& cacheFile)
+		: _root(root), _cacheFile(cacheFile.value_or(root / "ProcessedFolderCatalog.cache"))
+	{
+		if (!fs::is_directory(root)) {
+			throw std::invalid_argument(root.string() + " is not a directory");
+		}
+
+		std::vector<fs::path> candidates = { root };
+		for (const fs::directory_entry& entry : fs::directory_iterator(root)) {
+			if (entry.is_directory()) {
+				candidates.push_back(entry.path());
+			}
+		}
+		std::sort(candidates.begin() + 1, candidates.end());
+
+		std::unordered_map<std::string, CatalogEntry> cache = _readCache();
+		std::error_code ec;
+		fs::path cacheDir = fs::absolute(_cacheFile, ec).parent_path();
+
+		struct Found {
+			std::optional<CatalogEntry> entry;
+			bool fromCache = false;
+		};
+		std::function<Found(size_t)> describe = [&](size_t i)->Found {
+			const fs::path& dir = candidates[i];
+			try {
+				auto cached = cache.find(dir.generic_string());
+				if (cached != cache.end() && runStamp(cached->second.watched, cacheDir) == cached->second.stamp) {
+					return Found{ cached->second, true };
+				}
+				return Found{ describeRun(dir, cacheDir), false };
+			}
+			catch (...) {
+				return Found{};
+			}
+			};
+		std::function<void(size_t, Found&)> collect = [&](size_t, Found& found) {
+			if (found.entry) {
+				_entries.push_back(std::move(found.entry.value()));
+				if (found.fromCache) {
+					++_nFromCache;
+				}
+			}
+			};
+		orderedParallelFor(candidates.size(), describe, collect);
+
+		if (_nFromCache != _entries.size() || _entries.size() != cache.size()) {
+			try {
+				writeCache();
+			}
+			catch (std::runtime_error e) {
+				std::cerr << "Could not write catalog cache to " << _cacheFile.string() << "\n";
+			}
+		}
+	}
+
+	const std::vector<CatalogEntry>& ProcessedFolderCatalog::entries() const
+	{
+		return _entries;
+	}
+
+	size_t ProcessedFolderCatalog::size() const
+	{
+		return _entries.size();
+	}
+
+	const CatalogEntry& ProcessedFolderCatalog::operator[](size_t index) const
+	{
+		return _entries[index];
+	}
+
+	std::unique_ptr<ProcessedFolder> ProcessedFolderCatalog::open(size_t index) const
+	{
+		if (index >= _entries.size()) {
+			return std::unique_ptr<ProcessedFolder>();
+		}
+		return openProcessedFolder(_entries[index].dir, _entries[index].type);
+	}
+
+	size_t ProcessedFolderCatalog::nFromCache() const
+	{
+		return _nFromCache;
+	}
+
+	//The cache is a text file. After the header line, each run is:
+	//a line with the stamp, type, tile count, and number of watched directories; a line with the directory; one line per watched directory;
+	//a line with the crs as wkt; a line with the extent
+	//and then one line per tile with its extent, or a single - for tiles with no data
+	void ProcessedFolderCatalog::writeCache() const
+	{
+		fs::path tempFile = temporaryPath(_cacheFile);
+		{
+			std::ofstream out{ tempFile };
+			if (!out) {
+				throw std::runtime_error("Unable to open " + tempFile.string());
+			}
+			out << std::setprecision(17);
+			out << catalogCacheHeader << "\n";
+			auto writeExtent = [&](const lapis::Extent& e) {
+				out << e.xmin() << " " << e.xmax() << " " << e.ymin() << " " << e.ymax() << "\n";
+				};
+			for (const CatalogEntry& entry : _entries) {
+				out << entry.stamp << " " << (int)entry.type << " " << entry.nTiles << " " << entry.watched.size() << "\n";
+				out << entry.dir.generic_string() << "\n";
+				for (const fs::path& watched : entry.watched) {
+					out << watched.generic_string() << "\n";
+				}
+				out << singleLine(entry.crs.getCompleteWKT()) << "\n";
+				writeExtent(entry.extent);
+				for (const std::optional<lapis::Extent>& tile : entry.tileExtents) {
+					if (tile) {
+						writeExtent(tile.value());
+					}
+					else {
+						out << "-\n";
+					}
+				}
+			}
+			if (!out) {
+				throw std::runtime_error("Unable to write " + tempFile.string());
+			}
+		}
+		//so a reader never sees a half-written cache
+		std::error_code ec;
+		fs::rename(tempFile, _cacheFile, ec);
+		if (ec) {
+			fs::remove(tempFile, ec);
+			throw std::runtime_error("Unable to replace " + _cacheFile.string());
+		}
+	}
+
+	std::unordered_map<std::string, CatalogEntry> ProcessedFolderCatalog::_readCache() const
+	{
+		std::unordered_map<std::string, CatalogEntry> out;
+		std::ifstream in{ _cacheFile };
+		if (!in) {
+			return out;
+		}
+		std::string line;
+		if (!std::getline(in, line) || line != catalogCacheHeader) {
+			return out;
+		}
+
+		auto readExtent = [&](const std::string& s, const lapis::CoordRef& crs)->std::optional<lapis::Extent> {
+			std::istringstream ss{ s };
+			lapis::coord_t xmin, xmax, ymin, ymax;
+			if (!(ss >> xmin >> xmax >> ymin >> ymax)) {
+				return std::nullopt;
+			}
+			return lapis::Extent(xmin, xmax, ymin, ymax, crs);
+			};
+
+		//a malformed entry means the rest of the file can't be trusted, but everything before it is still usable
+		while (std::getline(in, line)) {
+			CatalogEntry entry;
+			std::istringstream header{ line };
+			int type;
+			size_t nWatched;
+			if (!(header >> entry.stamp >> type >> entry.nTiles >> nWatched)) {
+				break;
+			}
+			entry.type = (RunType)type;
+
+			std::string dir, wkt, extent;
+			if (!std::getline(in, dir)) {
+				break;
+			}
+			entry.dir = dir;
+			bool good = true;
+			for (size_t i = 0; i < nWatched && good; ++i) {
+				good = (bool)std::getline(in, line);
+				entry.watched.push_back(line);
+			}
+			if (!good || !std::getline(in, wkt) || !std::getline(in, extent)) {
+				break;
+			}
+			try {
+				entry.crs = lapis::CoordRef(wkt);
+			}
+			catch (...) {
+				break;
+			}
+			std::optional<lapis::Extent> e = readExtent(extent, entry.crs);
+			if (!e) {
+				break;
+			}
+			entry.extent = e.value();
+
+			for (size_t i = 0; i < entry.nTiles && good; ++i) {
+				if (!std::getline(in, line)) {
+					good = false;
+				}
+				else if (line == "-") {
+					entry.tileExtents.push_back(std::nullopt);
+				}
+				else {
+					std::optional<lapis::Extent> tile = readExtent(line, entry.crs);
+					good = tile.has_value();
+					entry.tileExtents.push_back(tile);
+				}
+			}
+			if (!good) {
+				break;
+			}
+			out.emplace(entry.dir.generic_string(), std::move(entry));
+		}
+		return out;
+	}
+}
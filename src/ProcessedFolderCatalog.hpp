@@ -0,0 +1,49 @@
+#pragma once
+#ifndef PROCESSEDFOLDERCATALOG_H
+#define PROCESSEDFOLDERCATALOG_H
+
+#include "ProcessedFolder.hpp"
+
+namespace processedfolder {
+	//What the catalog knows about a run without opening it
+	struct CatalogEntry {
+		std::filesystem::path dir;
+		RunType type = RunType::lapis;
+		lapis::CoordRef crs;
+		lapis::Extent extent;
+		size_t nTiles = 0;
+		std::vector<std::optional<lapis::Extent>> tileExtents; //empty for tiles with no data
+		std::vector<std::filesystem::path> watched; //the directories the run was read from
+		uint64_t stamp = 0; //derived from the modification times of the watched directories, used to tell if a cached entry is stale
+	};
+
+	//Finds every processed run directly inside a root folder, opening them in parallel
+	//The metadata of each run is saved to a cache file, and on the next start runs whose directories haven't changed are read from the cache instead of being opened
+	class ProcessedFolderCatalog {
+	public:
+		//the cache defaults to ProcessedFolderCatalog.cache inside root
+		ProcessedFolderCatalog(const std::filesystem::path& root, const std::optional<std::filesystem::path>& cacheFile = std::nullopt);
+
+		const std::vector<CatalogEntry>& entries() const;
+		size_t size() const;
+		const CatalogEntry& operator[](size_t index) const;
+
+		//fully opens one of the runs. Returns an empty pointer if it no longer opens
+		std::unique_ptr<ProcessedFolder> open(size_t index) const;
+
+		//the number of entries that were taken from the cache rather than opened
+		size_t nFromCache() const;
+
+		void writeCache() const;
+
+	private:
+		std::filesystem::path _root;
+		std::filesystem::path _cacheFile;
+		std::vector<CatalogEntry> _entries;
+		size_t _nFromCache = 0;
+
+		std::unordered_map<std::string, CatalogEntry> _readCache() const;
+	};
+}
+
+#endif
@@ -8,6 +8,27 @@
 #include<filesystem>
 #include<regex>
 #include<queue>
+#include<unordered_set>
+#include<unordered_map>
+#include<shared_mutex>
+#include<algorithm>
+#include<functional>
+#include<atomic>
+#include<mutex>
+#include<thread>
+#include<future>
+#include<condition_variable>
+#include<deque>
+#include<numeric>
+#include<any>
+#include<list>
+#include<limits>
+#include<fstream>
+#include<sstream>
+#include<iomanip>
+#include<cstring>
+#include<cerrno>
+#include<cmath>
 
 #include<Raster.hpp>
 #include<RasterAlgos.hpp>
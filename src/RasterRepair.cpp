@@ -0,0 +1,35 @@
+#include "RasterRepair.hpp"
+
+namespace processedfolder {
+	lapis::Alignment repairAlignment(const lapis::Alignment& a, lapis::coord_t expectedXRes, lapis::coord_t expectedYRes, lapis::coord_t expectedXOrigin, lapis::coord_t expectedYOrigin, double tolerance)
+	{
+		if (a.xres() == expectedXRes && a.yres() == expectedYRes) {
+			return a;
+		}
+
+		auto xmin = a.xmin();
+		auto ymin = a.ymin();
+		auto xres = a.xres();
+		auto yres = a.yres();
+		if (a.xres() != expectedXRes) {
+			if (std::abs(a.xres() - expectedXRes) / expectedXRes < tolerance) {
+				xmin = expectedXOrigin + std::round((a.xmin() - expectedXOrigin) / expectedXRes) * expectedXRes;
+				xres = expectedXRes;
+			}
+			else {
+				throw lapis::AlignmentMismatchException("Raster not repairable");
+			}
+		}
+		if (a.yres() != expectedYRes) {
+			if (std::abs(a.yres() - expectedYRes) / expectedYRes < tolerance) {
+				ymin = expectedYOrigin + std::round((a.ymin() - expectedYOrigin) / expectedYRes) * expectedYRes;
+				yres = expectedYRes;
+			}
+			else {
+				throw lapis::AlignmentMismatchException("Raster not repairable");
+			}
+		}
+
+		return lapis::Alignment{ xmin, ymin, a.nrow(), a.ncol(), xres, yres, a.crs() };
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef RASTERREPAIR_H
+#define RASTERREPAIR_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//Repairs an issue that emerges in certain fusion runs where the resolution (and by extension, the origin and extent) get slightly messed up
+	//You specify an expected resolution and origin and a tolerance. If the actual resolution is farther from the expected than the tolerance, the alignment is considered unrepairable and an exception is thrown
+	//Otherwise, the resolution is set to be the expected resolution and the extent is snapped to the grid inferred from the origin and resolution
+	//The number of rows and columns is kept, so cell i of the repaired alignment is cell i of the original
+	lapis::Alignment repairAlignment(const lapis::Alignment& a, lapis::coord_t expectedXRes, lapis::coord_t expectedYRes, lapis::coord_t expectedXOrigin, lapis::coord_t expectedYOrigin, double tolerance = 0.1);
+
+	//repairAlignment, applied to a raster
+	template<class T>
+	lapis::Raster<T> repairResolution(const lapis::Raster<T>& r, lapis::coord_t expectedXRes, lapis::coord_t expectedYRes, lapis::coord_t expectedXOrigin, lapis::coord_t expectedYOrigin, double tolerance = 0.1) {
+		if (r.xres() == expectedXRes && r.yres() == expectedYRes) {
+			return(r);
+		}
+		
+		lapis::Alignment a = repairAlignment(r, expectedXRes, expectedYRes, expectedXOrigin, expectedYOrigin, tolerance);
+		lapis::Raster<T> out{ a };
+		for (lapis::cell_t c = 0; c < out.ncell(); ++c) {
+			out[c].value() = r[c].value();
+			out[c].has_value() = r[c].has_value();
+		}
+		return(out);
+	}
+}
+
+#endif
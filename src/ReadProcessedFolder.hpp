@@ -7,26 +7,63 @@
 #include "LidRFolder.hpp"
 
 namespace processedfolder {
-	static std::unique_ptr<ProcessedFolder> readProcessedFolder(const std::string& folder)
+	//Identifies the type of run from a few marker files, without opening it
+	//Lapis is checked first because its two marker files are cheap to probe, while finding a FUSION root means searching the folder tree
+	static std::optional<RunType> detectRunType(const std::filesystem::path& folder)
 	{
 		try {
-			std::unique_ptr<ProcessedFolder> out = std::make_unique<FusionFolder>(folder);
-			return out;
+			if (isLapisFolder(folder)) {
+				return RunType::lapis;
+			}
+			if (isFusionFolder(folder)) {
+				return RunType::fusion;
+			}
+			if (isLidRFolder(folder)) {
+				return RunType::lidr;
+			}
 		}
-		catch (...) {}
+		catch (std::filesystem::filesystem_error e) {}
+		return std::nullopt;
+	}
 
+	//Opens a folder whose type is already known. Returns an empty pointer if it can't be opened as that type
+	static std::unique_ptr<ProcessedFolder> openProcessedFolder(const std::filesystem::path& folder, RunType type)
+	{
 		try {
-			std::unique_ptr<ProcessedFolder> out = std::make_unique<LapisFolder>(folder);
-			return out;
+			switch (type) {
+			case RunType::fusion:
+				return std::make_unique<FusionFolder>(folder);
+			case RunType::lapis:
+				return std::make_unique<LapisFolder>(folder);
+			case RunType::lidr:
+				return std::make_unique<LidRFolder>(folder);
+			}
 		}
 		catch (...) {}
 
-		try {
-			std::unique_ptr<ProcessedFolder> out = std::make_unique<LidRFolder>(folder);
-			return out;
+		return std::unique_ptr<ProcessedFolder>();
+	}
+
+	static std::unique_ptr<ProcessedFolder> readProcessedFolder(const std::string& folder)
+	{
+		std::optional<RunType> type = detectRunType(folder);
+		if (type) {
+			std::unique_ptr<ProcessedFolder> out = openProcessedFolder(folder, type.value());
+			if (out) {
+				return out;
+			}
 		}
-		catch (...) {}
 
+		//if the markers were misleading, every type is tried in turn, as before they were checked
+		for (RunType other : { RunType::fusion, RunType::lapis, RunType::lidr }) {
+			if (type && other == type.value()) {
+				continue;
+			}
+			std::unique_ptr<ProcessedFolder> out = openProcessedFolder(folder, other);
+			if (out) {
+				return out;
+			}
+		}
 		return std::unique_ptr<ProcessedFolder>();
 	}
 } //namespace processedfolder
@@ -0,0 +1,69 @@
+#include "TaoIdLookup.hpp"
+
+namespace processedfolder {
+	TaoIdLookup::TaoIdLookup(TaoTable table) : _table(std::move(table))
+	{
+		lapis::taoid_t minId = std::numeric_limits<lapis::taoid_t>::max();
+		lapis::taoid_t maxId = 0;
+		size_t nWithId = 0;
+		for (lapis::taoid_t id : _table.id) {
+			if (id) {
+				minId = std::min(minId, id);
+				maxId = std::max(maxId, id);
+				++nWithId;
+			}
+		}
+		if (!nWithId) {
+			return;
+		}
+
+		//a flat array is used unless most of it would be empty
+		size_t range = (size_t)(maxId - minId) + 1;
+		if (range <= 4 * nWithId + 1024 && _table.size() < std::numeric_limits<uint32_t>::max()) {
+			_minId = minId;
+			_dense.assign(range, 0);
+			for (size_t i = 0; i < _table.size(); ++i) {
+				if (_table.id[i]) {
+					_dense[_table.id[i] - _minId] = (uint32_t)(i + 1);
+				}
+			}
+		}
+		else {
+			_sparse.reserve(nWithId);
+			for (size_t i = 0; i < _table.size(); ++i) {
+				if (_table.id[i]) {
+					_sparse[_table.id[i]] = i;
+				}
+			}
+		}
+	}
+
+	std::optional<size_t> TaoIdLookup::find(lapis::taoid_t id) const
+	{
+		if (!id) {
+			return std::nullopt;
+		}
+		if (_dense.size()) {
+			if (id < _minId || (size_t)(id - _minId) >= _dense.size() || !_dense[id - _minId]) {
+				return std::nullopt;
+			}
+			return (size_t)_dense[id - _minId] - 1;
+		}
+		auto found = _sparse.find(id);
+		if (found == _sparse.end()) {
+			return std::nullopt;
+		}
+		return found->second;
+	}
+
+	const TaoTable& TaoIdLookup::table() const
+	{
+		return _table;
+	}
+
+	void TaoIdLookupCache::clear()
+	{
+		std::lock_guard lock{ mut };
+		byTile.clear();
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef TAOIDLOOKUP_H
+#define TAOIDLOOKUP_H
+
+#include "ProcessedFolder_pch.hpp"
+#include "TaoTable.hpp"
+
+namespace processedfolder {
+	//Finds a tile's TAOs by ID in constant time, for joining the cells of a segment raster back to their TAOs
+	//IDs are held in a flat array when they're compact, as they usually are, and in a hash map otherwise
+	class TaoIdLookup {
+	public:
+		TaoIdLookup() = default;
+		TaoIdLookup(TaoTable table);
+
+		//the row of table() with this ID, or nullopt if there isn't one
+		//TAOs with an ID of 0, which includes every TAO from a file with no ID field, can't be found
+		std::optional<size_t> find(lapis::taoid_t id) const;
+
+		const TaoTable& table() const;
+
+	private:
+		TaoTable _table;
+
+		//_dense[id - _minId] is the row with that ID plus one, or 0 for none
+		lapis::taoid_t _minId = 0;
+		std::vector<uint32_t> _dense;
+		std::unordered_map<lapis::taoid_t, size_t> _sparse;
+	};
+
+	//The lookups that have been built for each tile of a folder
+	struct TaoIdLookupCache {
+		std::mutex mut;
+		std::unordered_map<size_t, std::shared_ptr<const TaoIdLookup>> byTile;
+
+		void clear();
+	};
+}
+
+#endif
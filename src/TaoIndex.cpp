@@ -0,0 +1,321 @@
+#include "TaoIndex.hpp"
+#include "MappedFile.hpp"
+#include "TempFile.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	//The saved index is a header, then the _cellStart array, then one TaoIndexRecord per TAO in grid order
+	struct TaoIndexHeader {
+		char magic[8];
+		TaoSourceStamp stamp;
+		double xmin;
+		double ymin;
+		double cellSize;
+		uint64_t ncol;
+		uint64_t nrow;
+		uint64_t nRecord;
+	};
+	struct TaoIndexRecord {
+		double x;
+		double y;
+		double height;
+		double area;
+		uint32_t id;
+		uint32_t tile;
+	};
+	static constexpr char taoIndexMagic[8] = { 'P', 'F', 'T', 'A', 'O', 'I', 'X', '1' };
+
+	//beyond this, a bigger cell size is used instead, so a few outliers can't blow up the grid
+	static constexpr size_t maxTaoIndexCells = 1 << 24;
+
+	TaoIndex::TaoIndex(const TaoTable& table, lapis::coord_t cellSize)
+	{
+		if (!table.size()) {
+			return;
+		}
+		auto [xminIt, xmaxIt] = std::minmax_element(table.x.begin(), table.x.end());
+		auto [yminIt, ymaxIt] = std::minmax_element(table.y.begin(), table.y.end());
+		_xmin = *xminIt;
+		_ymin = *yminIt;
+		lapis::coord_t width = std::max<lapis::coord_t>(*xmaxIt - _xmin, 1e-6);
+		lapis::coord_t height = std::max<lapis::coord_t>(*ymaxIt - _ymin, 1e-6);
+
+		if (cellSize <= 0) {
+			//about four TAOs per cell
+			cellSize = std::sqrt(width * height * 4 / (lapis::coord_t)table.size());
+		}
+		cellSize = std::max(cellSize, std::sqrt(width * height / (lapis::coord_t)maxTaoIndexCells));
+		cellSize = std::max<lapis::coord_t>(cellSize, 1e-6);
+		//the area bound alone lets a long, thin spread of TAOs have far too many columns or rows
+		auto nCells = [&](lapis::coord_t size) { return (std::floor(width / size) + 1) * (std::floor(height / size) + 1); };
+		while (nCells(cellSize) > (lapis::coord_t)maxTaoIndexCells) {
+			cellSize *= 1.25;
+		}
+		_cellSize = cellSize;
+		_ncol = (size_t)(width / _cellSize) + 1;
+		_nrow = (size_t)(height / _cellSize) + 1;
+
+		//a counting sort of the TAOs into their cells
+		std::vector<size_t> cellOf(table.size());
+		_cellStart.assign(_ncol * _nrow + 1, 0);
+		for (size_t i = 0; i < table.size(); ++i) {
+			cellOf[i] = _rowFromY(table.y[i]) * _ncol + _colFromX(table.x[i]);
+			++_cellStart[cellOf[i] + 1];
+		}
+		for (size_t c = 1; c < _cellStart.size(); ++c) {
+			_cellStart[c] += _cellStart[c - 1];
+		}
+		std::vector<size_t> order(table.size());
+		std::vector<size_t> next(_cellStart.begin(), _cellStart.end() - 1);
+		for (size_t i = 0; i < table.size(); ++i) {
+			order[next[cellOf[i]]++] = i;
+		}
+
+		_table.reserve(table.size());
+		for (size_t i : order) {
+			_table.push_back(table.x[i], table.y[i], table.height[i], table.area[i], table.id[i], table.tile[i]);
+		}
+	}
+
+	const TaoTable& TaoIndex::table() const
+	{
+		return _table;
+	}
+
+	size_t TaoIndex::size() const
+	{
+		return _table.size();
+	}
+
+	size_t TaoIndex::_colFromX(lapis::coord_t x) const
+	{
+		if (x <= _xmin) {
+			return 0;
+		}
+		return std::min((size_t)((x - _xmin) / _cellSize), _ncol - 1);
+	}
+
+	size_t TaoIndex::_rowFromY(lapis::coord_t y) const
+	{
+		if (y <= _ymin) {
+			return 0;
+		}
+		return std::min((size_t)((y - _ymin) / _cellSize), _nrow - 1);
+	}
+
+	template<class F>
+	void TaoIndex::_forEachInCells(size_t col0, size_t row0, size_t col1, size_t row1, F&& f) const
+	{
+		for (size_t row = row0; row <= row1; ++row) {
+			for (size_t col = col0; col <= col1; ++col) {
+				size_t cell = row * _ncol + col;
+				for (size_t i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i) {
+					f(i);
+				}
+			}
+		}
+	}
+
+	std::vector<size_t> TaoIndex::inRadius(lapis::coord_t x, lapis::coord_t y, lapis::coord_t radius) const
+	{
+		std::vector<size_t> out;
+		if (!size() || radius < 0) {
+			return out;
+		}
+		lapis::coord_t r2 = radius * radius;
+		_forEachInCells(_colFromX(x - radius), _rowFromY(y - radius), _colFromX(x + radius), _rowFromY(y + radius), [&](size_t i) {
+			lapis::coord_t dx = _table.x[i] - x;
+			lapis::coord_t dy = _table.y[i] - y;
+			if (dx * dx + dy * dy <= r2) {
+				out.push_back(i);
+			}
+			});
+		return out;
+	}
+
+	std::vector<size_t> TaoIndex::inBox(const lapis::Extent& e) const
+	{
+		std::vector<size_t> out;
+		if (!size()) {
+			return out;
+		}
+		_forEachInCells(_colFromX(e.xmin()), _rowFromY(e.ymin()), _colFromX(e.xmax()), _rowFromY(e.ymax()), [&](size_t i) {
+			if (e.contains(_table.x[i], _table.y[i])) {
+				out.push_back(i);
+			}
+			});
+		return out;
+	}
+
+	std::vector<size_t> TaoIndex::nearest(lapis::coord_t x, lapis::coord_t y, size_t k) const
+	{
+		std::vector<size_t> out;
+		if (!size() || !k) {
+			return out;
+		}
+
+		//a max-heap of the best k so far, by squared distance
+		std::vector<std::pair<lapis::coord_t, size_t>> best;
+		auto consider = [&](size_t i) {
+			lapis::coord_t dx = _table.x[i] - x;
+			lapis::coord_t dy = _table.y[i] - y;
+			lapis::coord_t d2 = dx * dx + dy * dy;
+			if (best.size() < k) {
+				best.emplace_back(d2, i);
+				std::push_heap(best.begin(), best.end());
+			}
+			else if (d2 < best.front().first) {
+				std::pop_heap(best.begin(), best.end());
+				best.back() = { d2, i };
+				std::push_heap(best.begin(), best.end());
+			}
+			};
+
+		//searches square rings of cells outward from the cell nearest the point
+		//once the point is inside the searched block, nothing outside it can be closer than the block's nearest edge
+		long long col = (long long)_colFromX(x);
+		long long row = (long long)_rowFromY(y);
+		long long maxRing = (long long)std::max(_ncol, _nrow);
+		for (long long ring = 0; ring <= maxRing; ++ring) {
+			long long c0 = col - ring, c1 = col + ring, r0 = row - ring, r1 = row + ring;
+			for (long long r = std::max(r0, 0ll); r <= std::min(r1, (long long)_nrow - 1); ++r) {
+				for (long long c = std::max(c0, 0ll); c <= std::min(c1, (long long)_ncol - 1); ++c) {
+					if (r != r0 && r != r1 && c != c0 && c != c1) {
+						continue;
+					}
+					size_t cell = (size_t)r * _ncol + (size_t)c;
+					for (size_t i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i) {
+						consider(i);
+					}
+				}
+			}
+
+			if (best.size() == k) {
+				lapis::coord_t bxmin = _xmin + c0 * _cellSize;
+				lapis::coord_t bxmax = _xmin + (c1 + 1) * _cellSize;
+				lapis::coord_t bymin = _ymin + r0 * _cellSize;
+				lapis::coord_t bymax = _ymin + (r1 + 1) * _cellSize;
+				if (x >= bxmin && x <= bxmax && y >= bymin && y <= bymax) {
+					lapis::coord_t edge = std::min({ x - bxmin, bxmax - x, y - bymin, bymax - y });
+					if (edge * edge >= best.front().first) {
+						break;
+					}
+				}
+			}
+		}
+
+		std::sort_heap(best.begin(), best.end());
+		for (const auto& b : best) {
+			out.push_back(b.second);
+		}
+		return out;
+	}
+
+	bool TaoIndex::save(const fs::path& file, const TaoSourceStamp& stamp) const
+	{
+		fs::path temp = temporaryPath(file);
+
+		TaoIndexHeader header{};
+		std::copy(std::begin(taoIndexMagic), std::end(taoIndexMagic), header.magic);
+		header.stamp = stamp;
+		header.xmin = _xmin;
+		header.ymin = _ymin;
+		header.cellSize = _cellSize;
+		header.ncol = _ncol;
+		header.nrow = _nrow;
+		header.nRecord = _table.size();
+
+		std::vector<uint64_t> cellStart(_cellStart.begin(), _cellStart.end());
+		std::vector<TaoIndexRecord> records(_table.size());
+		for (size_t i = 0; i < _table.size(); ++i) {
+			records[i] = TaoIndexRecord{ _table.x[i], _table.y[i], _table.height[i], _table.area[i], _table.id[i], _table.tile[i] };
+		}
+
+		std::error_code ec;
+		{
+			std::ofstream out{ temp, std::ios::binary };
+			if (!out) {
+				return false;
+			}
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(cellStart.data()), (std::streamsize)(cellStart.size() * sizeof(uint64_t)));
+			out.write(reinterpret_cast<const char*>(records.data()), (std::streamsize)(records.size() * sizeof(TaoIndexRecord)));
+			if (!out) {
+				out.close();
+				fs::remove(temp, ec);
+				return false;
+			}
+		}
+		fs::rename(temp, file, ec);
+		if (ec) {
+			fs::remove(temp, ec);
+			return false;
+		}
+		return true;
+	}
+
+	std::optional<TaoIndex> TaoIndex::load(const fs::path& file, const TaoSourceStamp& stamp)
+	{
+		std::error_code ec;
+		if (!fs::exists(file, ec)) {
+			return std::nullopt;
+		}
+		try {
+			MappedFile mapped{ file };
+			if (mapped.size() < sizeof(TaoIndexHeader)) {
+				return std::nullopt;
+			}
+			TaoIndexHeader header;
+			std::memcpy(&header, mapped.data(), sizeof(header));
+			if (!std::equal(std::begin(header.magic), std::end(header.magic), std::begin(taoIndexMagic)) || !(header.stamp == stamp)) {
+				return std::nullopt;
+			}
+			//the header is checked before anything is sized from it, so a damaged file can't overflow the arithmetic below
+			size_t maxEntries = mapped.size() / sizeof(uint64_t);
+			if (!std::isfinite(header.cellSize) || !(header.cellSize > 0) || header.nRecord > mapped.size() / sizeof(TaoIndexRecord)) {
+				return std::nullopt;
+			}
+			if (header.nRecord && (header.ncol == 0 || header.nrow == 0 || header.ncol > maxEntries || header.nrow > maxEntries / header.ncol)) {
+				return std::nullopt;
+			}
+			size_t nCellStart = header.nRecord ? (size_t)(header.ncol * header.nrow + 1) : 0;
+			if (mapped.size() != sizeof(TaoIndexHeader) + nCellStart * sizeof(uint64_t) + header.nRecord * sizeof(TaoIndexRecord)) {
+				return std::nullopt;
+			}
+
+			//the cell starts must run from 0 to the record count without going backwards, or queries would read past the records
+			const uint64_t* cellStart = reinterpret_cast<const uint64_t*>(mapped.data() + sizeof(TaoIndexHeader));
+			if (nCellStart) {
+				if (cellStart[0] != 0 || cellStart[nCellStart - 1] != header.nRecord) {
+					return std::nullopt;
+				}
+				for (size_t i = 1; i < nCellStart; ++i) {
+					if (cellStart[i] < cellStart[i - 1]) {
+						return std::nullopt;
+					}
+				}
+			}
+
+			TaoIndex out;
+			out._xmin = header.xmin;
+			out._ymin = header.ymin;
+			out._cellSize = header.cellSize;
+			out._ncol = (size_t)header.ncol;
+			out._nrow = (size_t)header.nrow;
+
+			out._cellStart.assign(cellStart, cellStart + nCellStart);
+
+			const TaoIndexRecord* records = reinterpret_cast<const TaoIndexRecord*>(mapped.data() + sizeof(TaoIndexHeader) + nCellStart * sizeof(uint64_t));
+			out._table.reserve((size_t)header.nRecord);
+			for (size_t i = 0; i < header.nRecord; ++i) {
+				const TaoIndexRecord& r = records[i];
+				out._table.push_back(r.x, r.y, r.height, r.area, r.id, r.tile);
+			}
+			return out;
+		}
+		catch (std::runtime_error e) {
+			return std::nullopt;
+		}
+	}
+}
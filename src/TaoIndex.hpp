@@ -0,0 +1,53 @@
+#pragma once
+#ifndef TAOINDEX_H
+#define TAOINDEX_H
+
+#include "ProcessedFolder_pch.hpp"
+#include "TaoTable.hpp"
+
+namespace processedfolder {
+	//A uniform grid over a set of TAOs, for radius, nearest-neighbour, and box queries without scanning every tree
+	//The TAOs are reordered so each grid cell's TAOs are contiguous; queries return indices into table()
+	class TaoIndex {
+	public:
+		TaoIndex() = default;
+		//cellSize of 0 picks one that puts a few TAOs in each cell on average
+		TaoIndex(const TaoTable& table, lapis::coord_t cellSize = 0);
+
+		const TaoTable& table() const;
+		size_t size() const;
+
+		//the TAOs within radius of (x,y), edge included, in no particular order
+		std::vector<size_t> inRadius(lapis::coord_t x, lapis::coord_t y, lapis::coord_t radius) const;
+		//the k TAOs closest to (x,y), closest first. Fewer if there aren't k TAOs in the index
+		std::vector<size_t> nearest(lapis::coord_t x, lapis::coord_t y, size_t k) const;
+		//the TAOs inside e, edges included, in no particular order
+		std::vector<size_t> inBox(const lapis::Extent& e) const;
+
+		//Saves the index, recording which version of the source TAO file it was built from
+		//Returns false if the file couldn't be written; the index is still usable in that case
+		bool save(const std::filesystem::path& file, const TaoSourceStamp& stamp) const;
+		//nullopt if the file is missing, damaged, or was built from a different version of the source
+		static std::optional<TaoIndex> load(const std::filesystem::path& file, const TaoSourceStamp& stamp);
+
+	private:
+		TaoTable _table;
+
+		lapis::coord_t _xmin = 0;
+		lapis::coord_t _ymin = 0;
+		lapis::coord_t _cellSize = 1;
+		size_t _ncol = 0;
+		size_t _nrow = 0;
+
+		//the TAOs in grid cell c are _table entries _cellStart[c] through _cellStart[c+1]-1
+		//cells are numbered row by row, starting from _ymin
+		std::vector<size_t> _cellStart;
+
+		size_t _colFromX(lapis::coord_t x) const;
+		size_t _rowFromY(lapis::coord_t y) const;
+		template<class F>
+		void _forEachInCells(size_t col0, size_t row0, size_t col1, size_t row1, F&& f) const;
+	};
+}
+
+#endif
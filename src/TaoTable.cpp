@@ -0,0 +1,215 @@
+#include "TaoTable.hpp"
+#include "ProcessedFolder.hpp"
+#include "MappedFile.hpp"
+#include "TempFile.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	size_t TaoTable::size() const
+	{
+		return x.size();
+	}
+
+	void TaoTable::reserve(size_t n)
+	{
+		x.reserve(n);
+		y.reserve(n);
+		height.reserve(n);
+		area.reserve(n);
+		id.reserve(n);
+		tile.reserve(n);
+	}
+
+	void TaoTable::append(const TaoTable& other)
+	{
+		x.insert(x.end(), other.x.begin(), other.x.end());
+		y.insert(y.end(), other.y.begin(), other.y.end());
+		height.insert(height.end(), other.height.begin(), other.height.end());
+		area.insert(area.end(), other.area.begin(), other.area.end());
+		id.insert(id.end(), other.id.begin(), other.id.end());
+		tile.insert(tile.end(), other.tile.begin(), other.tile.end());
+	}
+
+	void TaoTable::push_back(lapis::coord_t x_, lapis::coord_t y_, lapis::coord_t height_, lapis::coord_t area_, lapis::taoid_t id_, uint32_t tile_)
+	{
+		x.push_back(x_);
+		y.push_back(y_);
+		height.push_back(height_);
+		area.push_back(area_);
+		id.push_back(id_);
+		tile.push_back(tile_);
+	}
+
+	std::optional<TaoFieldNames> standardTaoFields(const std::vector<std::string>& fieldNames)
+	{
+		auto has = [&](const std::string& name) {
+			return std::find(fieldNames.begin(), fieldNames.end(), name) != fieldNames.end();
+			};
+		if (!has("X") || !has("Y") || !has("Height") || !has("Area")) {
+			return std::nullopt;
+		}
+		return TaoFieldNames{ "X", "Y", "Height", "Area", has("ID") ? "ID" : "" };
+	}
+
+	//The sidecar is a header followed by one TaoRecord per TAO, in the order of the source file
+	//The header records the modification time and size of the .shp and .dbf it was made from, and it's ignored once those change
+	struct TaoRecord {
+		double x;
+		double y;
+		double height;
+		double area;
+		double id;
+	};
+	struct TaoSidecarHeader {
+		char magic[8];
+		TaoSourceStamp stamp;
+		uint64_t nRecord;
+		uint64_t hasId; //0 if the source file has no ID field, and the IDs are all 0
+	};
+	static constexpr char taoSidecarMagic[8] = { 'P', 'F', 'T', 'A', 'O', 'v', '0', '2' };
+
+	static fs::path taoSidecarPath(const fs::path& file) {
+		fs::path out = file;
+		out += ".taobin";
+		return out;
+	}
+
+	TaoSourceStamp taoSourceStamp(const fs::path& file)
+	{
+		TaoSourceStamp out;
+		std::error_code ec;
+		fs::path dbf = file;
+		dbf.replace_extension(".dbf");
+		out.shpTime = (uint64_t)fs::last_write_time(file, ec).time_since_epoch().count();
+		out.shpSize = (uint64_t)fs::file_size(file, ec);
+		out.dbfTime = (uint64_t)fs::last_write_time(dbf, ec).time_since_epoch().count();
+		out.dbfSize = (uint64_t)fs::file_size(dbf, ec);
+		return out;
+	}
+
+	//returns whether the file has IDs, or nullopt if there's no usable sidecar
+	static std::optional<bool> readTaoSidecar(const fs::path& file, const TaoSourceStamp& stamp, uint32_t tile, TaoTable& table,
+		const std::function<bool(lapis::coord_t, lapis::coord_t)>& keep) {
+		fs::path sidecar = taoSidecarPath(file);
+		std::error_code ec;
+		if (!fs::exists(sidecar, ec)) {
+			return std::nullopt;
+		}
+		try {
+			MappedFile mapped{ sidecar };
+			if (mapped.size() < sizeof(TaoSidecarHeader)) {
+				return std::nullopt;
+			}
+			TaoSidecarHeader header;
+			std::memcpy(&header, mapped.data(), sizeof(header));
+			if (!std::equal(std::begin(header.magic), std::end(header.magic), std::begin(taoSidecarMagic))
+				|| !(header.stamp == stamp)
+				|| mapped.size() != sizeof(TaoSidecarHeader) + header.nRecord * sizeof(TaoRecord)) {
+				return std::nullopt;
+			}
+
+			const TaoRecord* records = reinterpret_cast<const TaoRecord*>(mapped.data() + sizeof(TaoSidecarHeader));
+			table.reserve(table.size() + (size_t)header.nRecord);
+			for (size_t i = 0; i < header.nRecord; ++i) {
+				const TaoRecord& r = records[i];
+				if (keep && !keep(r.x, r.y)) {
+					continue;
+				}
+				table.push_back(r.x, r.y, r.height, r.area, (lapis::taoid_t)r.id, tile);
+			}
+			return header.hasId != 0;
+		}
+		catch (std::runtime_error e) {
+			return std::nullopt;
+		}
+	}
+
+	//Failing to write the sidecar isn't an error; run folders are often read-only
+	static void writeTaoSidecar(const fs::path& file, const TaoSourceStamp& stamp, const TaoTable& raw, bool hasId) {
+		fs::path sidecar = taoSidecarPath(file);
+		fs::path temp = temporaryPath(sidecar);
+
+		TaoSidecarHeader header{};
+		std::copy(std::begin(taoSidecarMagic), std::end(taoSidecarMagic), header.magic);
+		header.stamp = stamp;
+		header.nRecord = raw.size();
+		header.hasId = hasId ? 1 : 0;
+		std::vector<TaoRecord> records(raw.size());
+		for (size_t i = 0; i < raw.size(); ++i) {
+			records[i] = TaoRecord{ raw.x[i], raw.y[i], raw.height[i], raw.area[i], (double)raw.id[i] };
+		}
+
+		std::error_code ec;
+		{
+			std::ofstream out{ temp, std::ios::binary };
+			if (!out) {
+				return;
+			}
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(records.data()), (std::streamsize)(records.size() * sizeof(TaoRecord)));
+			if (!out) {
+				out.close();
+				fs::remove(temp, ec);
+				return;
+			}
+		}
+		fs::rename(temp, sidecar, ec);
+		if (ec) {
+			fs::remove(temp, ec);
+		}
+	}
+
+	bool readTaoFile(const fs::path& file, const TaoFieldResolver& resolveFields, uint32_t tile, TaoTable& table,
+		const std::function<bool(lapis::coord_t, lapis::coord_t)>& keep)
+	{
+		//taken before parsing, so if the file changes partway through, the sidecar is already stale
+		TaoSourceStamp stamp = taoSourceStamp(file);
+		std::optional<bool> sidecarHasId = readTaoSidecar(file, stamp, tile, table, keep);
+		if (sidecarHasId) {
+			return sidecarHasId.value();
+		}
+
+		lapis::UniqueGdalDataset ds = lapis::vectorGDALWrapper(file.string());
+		OGRLayer* layer = ds->GetLayer(0);
+		//everything here comes from the attributes, so the geometry isn't decoded at all
+		const char* ignored[] = { "OGR_GEOMETRY", nullptr };
+		layer->SetIgnoredFields(ignored);
+		OGRFeatureDefn* defn = layer->GetLayerDefn();
+
+		std::vector<std::string> fieldNames;
+		for (int i = 0; i < defn->GetFieldCount(); ++i) {
+			fieldNames.push_back(defn->GetFieldDefn(i)->GetNameRef());
+		}
+		std::optional<TaoFieldNames> names = resolveFields(fieldNames);
+		if (!names) {
+			throw FileNotFoundException("Could not find the TAO attributes in " + file.string());
+		}
+		int xIdx = defn->GetFieldIndex(names->x.c_str());
+		int yIdx = defn->GetFieldIndex(names->y.c_str());
+		int hIdx = defn->GetFieldIndex(names->height.c_str());
+		int aIdx = defn->GetFieldIndex(names->area.c_str());
+		int idIdx = names->id.size() ? defn->GetFieldIndex(names->id.c_str()) : -1;
+
+		//the sidecar holds every TAO in the file, so keep is applied afterwards
+		TaoTable raw;
+		raw.reserve((size_t)std::max<GIntBig>(layer->GetFeatureCount(), 0));
+		for (const auto& feature : layer) {
+			lapis::taoid_t id = idIdx >= 0 ? (lapis::taoid_t)feature->GetFieldAsInteger64(idIdx) : 0;
+			raw.push_back(feature->GetFieldAsDouble(xIdx), feature->GetFieldAsDouble(yIdx),
+				feature->GetFieldAsDouble(hIdx), feature->GetFieldAsDouble(aIdx), id, tile);
+		}
+		writeTaoSidecar(file, stamp, raw, idIdx >= 0);
+
+		if (!keep) {
+			table.append(raw);
+			return idIdx >= 0;
+		}
+		for (size_t i = 0; i < raw.size(); ++i) {
+			if (keep(raw.x[i], raw.y[i])) {
+				table.push_back(raw.x[i], raw.y[i], raw.height[i], raw.area[i], raw.id[i], tile);
+			}
+		}
+		return idIdx >= 0;
+	}
+}
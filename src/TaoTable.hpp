@@ -0,0 +1,61 @@
+#pragma once
+#ifndef TAOTABLE_H
+#define TAOTABLE_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//TAO attributes stored column by column, so bulk consumers don't go through a std::function and a by-name field lookup per tree
+	//Heights and areas are in the units of the run
+	struct TaoTable {
+		std::vector<lapis::coord_t> x;
+		std::vector<lapis::coord_t> y;
+		std::vector<lapis::coord_t> height;
+		std::vector<lapis::coord_t> area;
+		std::vector<lapis::taoid_t> id; //0 if the source file has no ID field
+		std::vector<uint32_t> tile;
+
+		size_t size() const;
+		void reserve(size_t n);
+		void append(const TaoTable& other);
+		void push_back(lapis::coord_t x, lapis::coord_t y, lapis::coord_t height, lapis::coord_t area, lapis::taoid_t id, uint32_t tile);
+	};
+
+	//The names of the fields holding each TAO attribute in one file. id is empty if the file doesn't have one
+	struct TaoFieldNames {
+		std::string x;
+		std::string y;
+		std::string height;
+		std::string area;
+		std::string id;
+	};
+
+	//Identifies one version of a TAO shapefile by the modification times and sizes of its .shp and .dbf
+	//Files derived from a TAO file record this, so they can tell when they've gone stale
+	struct TaoSourceStamp {
+		uint64_t shpTime = 0;
+		uint64_t shpSize = 0;
+		uint64_t dbfTime = 0;
+		uint64_t dbfSize = 0;
+
+		bool operator==(const TaoSourceStamp& other) const = default;
+	};
+	TaoSourceStamp taoSourceStamp(const std::filesystem::path& file);
+
+	//Picks the TAO fields out of the field names of a file, or returns nullopt if they can't all be found
+	using TaoFieldResolver = std::function<std::optional<TaoFieldNames>(const std::vector<std::string>&)>;
+
+	//The resolver for files that use the field names X, Y, Height, Area, and optionally ID, as Lapis and lidR runs do
+	std::optional<TaoFieldNames> standardTaoFields(const std::vector<std::string>& fieldNames);
+
+	//Appends the TAOs in file to table, resolving the field names once for the whole file
+	//The first read of a file also writes a binary sidecar next to it (file.taobin), and later reads memory-map that instead of parsing the shapefile
+	//The sidecar is remade automatically if the shapefile changes
+	//If keep is given, it's called with the x and y of each TAO, and TAOs it returns false for are skipped
+	//Returns whether the file has an ID field; if it doesn't, the IDs are all 0
+	//Throws FileNotFoundException if the fields can't be resolved
+	bool readTaoFile(const std::filesystem::path& file, const TaoFieldResolver& resolveFields, uint32_t tile, TaoTable& table,
+		const std::function<bool(lapis::coord_t, lapis::coord_t)>& keep = nullptr);
+}
+
+#endif
@@ -0,0 +1,26 @@
+#include "TempFile.hpp"
+
+#ifdef _WIN32
+#include<process.h>
+#else
+#include<unistd.h>
+#endif
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	fs::path temporaryPath(const fs::path& target)
+	{
+		static std::atomic<uint64_t> counter{ 0 };
+#ifdef _WIN32
+		int pid = _getpid();
+#else
+		int pid = (int)getpid();
+#endif
+		fs::path out = target;
+		out.replace_filename(target.stem().string() + ".tmp" + std::to_string(pid)
+			+ "_" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()))
+			+ "_" + std::to_string(counter++) + target.extension().string());
+		return out;
+	}
+}
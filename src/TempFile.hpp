@@ -0,0 +1,14 @@
+#pragma once
+#ifndef TEMPFILE_H
+#define TEMPFILE_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//A name in the same folder as target for a file that's written and then renamed over target, so a reader never sees half of it
+	//It's unique across processes and threads, so two jobs writing the same file never share a temporary one
+	//The extension is kept, for writers that pick a format from it
+	std::filesystem::path temporaryPath(const std::filesystem::path& target);
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "TileCache.hpp"
+
+namespace processedfolder {
+	TileCache::TileCache(size_t maxBytes) : _maxBytes(maxBytes)
+	{
+	}
+
+	void TileCache::clear()
+	{
+		std::lock_guard lock{ _mut };
+		_lru.clear();
+		_lookup.clear();
+		_bytesUsed = 0;
+	}
+
+	void TileCache::setMaxBytes(size_t maxBytes)
+	{
+		std::lock_guard lock{ _mut };
+		_maxBytes = maxBytes;
+		_evict();
+	}
+
+	size_t TileCache::maxBytes() const
+	{
+		std::lock_guard lock{ _mut };
+		return _maxBytes;
+	}
+
+	size_t TileCache::bytesUsed() const
+	{
+		std::lock_guard lock{ _mut };
+		return _bytesUsed;
+	}
+
+	size_t TileCache::hits() const
+	{
+		std::lock_guard lock{ _mut };
+		return _hits;
+	}
+
+	size_t TileCache::misses() const
+	{
+		std::lock_guard lock{ _mut };
+		return _misses;
+	}
+
+	std::string TileCache::_key(const std::string& product, size_t index)
+	{
+		return product + "/" + std::to_string(index);
+	}
+
+	std::any* TileCache::_find(const std::string& key)
+	{
+		auto it = _lookup.find(key);
+		if (it == _lookup.end()) {
+			return nullptr;
+		}
+		_lru.splice(_lru.begin(), _lru, it->second);
+		return &it->second->tile;
+	}
+
+	void TileCache::_insert(const std::string& key, std::any tile, size_t bytes)
+	{
+		auto it = _lookup.find(key);
+		if (it != _lookup.end()) {
+			_bytesUsed -= it->second->bytes;
+			_lru.erase(it->second);
+			_lookup.erase(it);
+		}
+		if (bytes > _maxBytes) {
+			return;
+		}
+		_lru.push_front(Entry{ key, std::move(tile), bytes });
+		_lookup[key] = _lru.begin();
+		_bytesUsed += bytes;
+		_evict();
+	}
+
+	void TileCache::_evict()
+	{
+		while (_bytesUsed > _maxBytes && _lru.size()) {
+			_bytesUsed -= _lru.back().bytes;
+			_lookup.erase(_lru.back().key);
+			_lru.pop_back();
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//An in-memory cache of decoded tile rasters, keyed by product name and tile index
+	//When the total size of the cached tiles goes over the budget, the least recently used tiles are dropped
+	//This is safe to use from several threads at once
+	class TileCache {
+	public:
+		TileCache(size_t maxBytes);
+
+		template<class T>
+		std::shared_ptr<const lapis::Raster<T>> get(const std::string& product, size_t index);
+
+		template<class T>
+		void put(const std::string& product, size_t index, std::shared_ptr<const lapis::Raster<T>> tile);
+
+		void clear();
+		void setMaxBytes(size_t maxBytes);
+
+		size_t maxBytes() const;
+		size_t bytesUsed() const;
+		size_t hits() const;
+		size_t misses() const;
+
+	private:
+		struct Entry {
+			std::string key;
+			std::any tile;
+			size_t bytes;
+		};
+
+		mutable std::mutex _mut;
+		std::list<Entry> _lru; //most recently used at the front
+		std::unordered_map<std::string, std::list<Entry>::iterator> _lookup;
+		size_t _maxBytes;
+		size_t _bytesUsed = 0;
+		size_t _hits = 0;
+		size_t _misses = 0;
+
+		static std::string _key(const std::string& product, size_t index);
+		std::any* _find(const std::string& key);
+		void _insert(const std::string& key, std::any tile, size_t bytes);
+		void _evict();
+	};
+
+	template<class T>
+	std::shared_ptr<const lapis::Raster<T>> TileCache::get(const std::string& product, size_t index)
+	{
+		std::lock_guard lock{ _mut };
+		std::any* found = _find(_key(product, index));
+		if (found) {
+			auto tile = std::any_cast<std::shared_ptr<const lapis::Raster<T>>>(found);
+			if (tile) {
+				++_hits;
+				return *tile;
+			}
+		}
+		++_misses;
+		return nullptr;
+	}
+
+	template<class T>
+	void TileCache::put(const std::string& product, size_t index, std::shared_ptr<const lapis::Raster<T>> tile)
+	{
+		size_t bytes = (size_t)tile->ncell() * (sizeof(T) + sizeof(bool));
+		std::lock_guard lock{ _mut };
+		_insert(_key(product, index), std::any(tile), bytes);
+	}
+}
+
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+#ifndef TILECURSOR_H
+#define TILECURSOR_H
+
+#include "ProcessedFolder_pch.hpp"
+#include "OgrFilter.hpp"
+#include "Parallel.hpp"
+
+namespace processedfolder {
+	//Walks the features of a run one tile at a time, so whole-run passes don't need every tile in memory at once
+	//With read-ahead, the next tile is read on another thread while the caller works on the current one, so at most two tiles are held
+	//Usage: while (cursor.next()) { for (auto ft : cursor.features()) {...} }
+	template<class T>
+	class TileCursor {
+	public:
+		//returns the features of a tile that belong to it, or nullopt if it has none
+		using Reader = std::function<std::optional<lapis::VectorDataset<T>>(size_t)>;
+
+		TileCursor(size_t nTile, Reader reader, bool readAhead = true)
+			: _nTile(nTile), _reader(std::move(reader)), _readAhead(readAhead) {
+			_request(0);
+		}
+
+		TileCursor(const TileCursor&) = delete;
+		TileCursor& operator=(const TileCursor&) = delete;
+		TileCursor(TileCursor&&) = default;
+		TileCursor& operator=(TileCursor&&) = default;
+
+		//moves to the next tile with any features, and returns false once there are none left
+		//an exception from reading a tile is rethrown here, and calling next() again carries on from the tile after it
+		bool next() {
+			_current.reset();
+			while (_nextTile < _nTile) {
+				size_t i = _nextTile++;
+				std::optional<lapis::VectorDataset<T>> data;
+				try {
+					data = _take(i);
+				}
+				catch (...) {
+					//the read-ahead future has been used up, so the next read has to be queued before leaving
+					_request(_nextTile);
+					throw;
+				}
+				_request(_nextTile);
+				if (data && data->nFeature()) {
+					_current = std::move(data);
+					_tile = i;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//only valid after next() has returned true
+		const lapis::VectorDataset<T>& features() const {
+			return _current.value();
+		}
+		size_t tile() const {
+			return _tile;
+		}
+
+	private:
+		size_t _nTile = 0;
+		Reader _reader;
+		bool _readAhead = true;
+
+		size_t _nextTile = 0;
+		size_t _tile = 0;
+		std::optional<lapis::VectorDataset<T>> _current;
+		std::future<std::optional<lapis::VectorDataset<T>>> _ahead;
+
+		void _request(size_t i) {
+			if (_readAhead && i < _nTile) {
+				_ahead = std::async(std::launch::async, [reader = _reader](size_t i) {
+					WorkerThreadScope scope;
+					return reader(i);
+					}, i);
+			}
+		}
+		std::optional<lapis::VectorDataset<T>> _take(size_t i) {
+			if (_readAhead) {
+				return _ahead.get();
+			}
+			return _reader(i);
+		}
+	};
+
+	//A cursor over tiles whose files hold only their own features, so each file is read whole
+	template<class T>
+	TileCursor<T> fileCursor(size_t nTile, const std::function<std::optional<std::filesystem::path>(size_t)>& byTile, bool readAhead, GeometryMode mode) {
+		return TileCursor<T>(nTile, [byTile, mode](size_t i)->std::optional<lapis::VectorDataset<T>> {
+			std::optional<std::filesystem::path> file = byTile(i);
+			if (!file) {
+				return std::nullopt;
+			}
+			if (mode == GeometryMode::none) {
+				OgrFilter filter;
+				filter.geometry = mode;
+				return readFiltered<T>(file.value(), filter);
+			}
+			return lapis::VectorDataset<T>(file.value());
+			}, readAhead);
+	}
+}
+
+#endif
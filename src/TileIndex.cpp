@@ -0,0 +1,110 @@
+#include "TileIndex.hpp"
+
+namespace processedfolder {
+	static bool bboxOverlaps(const lapis::Extent& a, const lapis::Extent& b) {
+		return a.xmin() <= b.xmax() && a.xmax() >= b.xmin() && a.ymin() <= b.ymax() && a.ymax() >= b.ymin();
+	}
+
+	TileIndex::TileIndex(const std::vector<lapis::Extent>& tileExtents) : _extents(tileExtents)
+	{
+		if (_extents.empty()) {
+			return;
+		}
+
+		lapis::coord_t xmax = std::numeric_limits<lapis::coord_t>::lowest();
+		lapis::coord_t ymax = std::numeric_limits<lapis::coord_t>::lowest();
+		_xmin = std::numeric_limits<lapis::coord_t>::max();
+		_ymin = std::numeric_limits<lapis::coord_t>::max();
+		lapis::coord_t spanSum = 0;
+		for (const lapis::Extent& e : _extents) {
+			_xmin = std::min(_xmin, e.xmin());
+			_ymin = std::min(_ymin, e.ymin());
+			xmax = std::max(xmax, e.xmax());
+			ymax = std::max(ymax, e.ymax());
+			spanSum += std::max(e.xspan(), e.yspan());
+		}
+
+		//roughly one grid cell per tile, so each tile lands in a handful of cells
+		_cellSize = spanSum / _extents.size();
+		if (!(_cellSize > 0)) {
+			_cellSize = std::max({ xmax - _xmin, ymax - _ymin, (lapis::coord_t)1 });
+		}
+		_ncol = (size_t)((xmax - _xmin) / _cellSize) + 1;
+		_nrow = (size_t)((ymax - _ymin) / _cellSize) + 1;
+
+		std::vector<size_t> counts(_ncol * _nrow + 1, 0);
+		auto forEachCell = [&](const lapis::Extent& e, auto&& f) {
+			size_t colMax = _colFromX(e.xmax());
+			size_t rowMax = _rowFromY(e.ymax());
+			for (size_t row = _rowFromY(e.ymin()); row <= rowMax; ++row) {
+				for (size_t col = _colFromX(e.xmin()); col <= colMax; ++col) {
+					f(row * _ncol + col);
+				}
+			}
+			};
+		for (const lapis::Extent& e : _extents) {
+			forEachCell(e, [&](size_t cell) { ++counts[cell + 1]; });
+		}
+		std::partial_sum(counts.begin(), counts.end(), counts.begin());
+		_cellStart = counts;
+
+		_cellTiles.resize(_cellStart.back());
+		std::vector<size_t> fill(_cellStart.begin(), _cellStart.end() - 1);
+		for (size_t i = 0; i < _extents.size(); ++i) {
+			forEachCell(_extents[i], [&](size_t cell) { _cellTiles[fill[cell]++] = i; });
+		}
+	}
+
+	std::vector<size_t> TileIndex::overlapping(const lapis::Extent& e) const
+	{
+		std::vector<size_t> out;
+		if (_extents.empty()) {
+			return out;
+		}
+		lapis::coord_t xmax = _xmin + _ncol * _cellSize;
+		lapis::coord_t ymax = _ymin + _nrow * _cellSize;
+		if (e.xmax() < _xmin || e.xmin() > xmax || e.ymax() < _ymin || e.ymin() > ymax) {
+			return out;
+		}
+
+		size_t colMax = _colFromX(e.xmax());
+		size_t rowMax = _rowFromY(e.ymax());
+		for (size_t row = _rowFromY(e.ymin()); row <= rowMax; ++row) {
+			for (size_t col = _colFromX(e.xmin()); col <= colMax; ++col) {
+				size_t cell = row * _ncol + col;
+				for (size_t i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i) {
+					size_t tile = _cellTiles[i];
+					if (bboxOverlaps(_extents[tile], e)) {
+						out.push_back(tile);
+					}
+				}
+			}
+		}
+		//a tile spanning several cells shows up once per cell
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+		return out;
+	}
+
+	const lapis::Extent& TileIndex::tileExtent(size_t index) const
+	{
+		return _extents[index];
+	}
+
+	size_t TileIndex::size() const
+	{
+		return _extents.size();
+	}
+
+	size_t TileIndex::_colFromX(lapis::coord_t x) const
+	{
+		lapis::coord_t col = std::floor((x - _xmin) / _cellSize);
+		return (size_t)std::clamp(col, (lapis::coord_t)0, (lapis::coord_t)(_ncol - 1));
+	}
+
+	size_t TileIndex::_rowFromY(lapis::coord_t y) const
+	{
+		lapis::coord_t row = std::floor((y - _ymin) / _cellSize);
+		return (size_t)std::clamp(row, (lapis::coord_t)0, (lapis::coord_t)(_nrow - 1));
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef TILEINDEX_H
+#define TILEINDEX_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//A uniform grid over the bounding boxes of a tile layout, so extent queries only have to look at nearby tiles
+	//Built once, and read-only afterwards
+	class TileIndex {
+	public:
+		TileIndex() = default;
+		TileIndex(const std::vector<lapis::Extent>& tileExtents);
+
+		//the indices of every tile whose bounding box overlaps e, in increasing order
+		//e is assumed to be in the same projection as the tiles
+		std::vector<size_t> overlapping(const lapis::Extent& e) const;
+
+		const lapis::Extent& tileExtent(size_t index) const;
+		size_t size() const;
+
+	private:
+		std::vector<lapis::Extent> _extents;
+
+		lapis::coord_t _xmin = 0;
+		lapis::coord_t _ymin = 0;
+		lapis::coord_t _cellSize = 1;
+		size_t _ncol = 0;
+		size_t _nrow = 0;
+
+		//the tiles in grid cell c are _cellTiles[_cellStart[c]] through _cellTiles[_cellStart[c+1]-1]
+		std::vector<size_t> _cellStart;
+		std::vector<size_t> _cellTiles;
+
+		size_t _colFromX(lapis::coord_t x) const;
+		size_t _rowFromY(lapis::coord_t y) const;
+	};
+}
+
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+#ifndef TILEMOSAIC_H
+#define TILEMOSAIC_H
+
+#include "Parallel.hpp"
+#include "TileCache.hpp"
+
+namespace processedfolder {
+	//Decodes one tile file, cropped to the extent if one is given
+	template<class T>
+	using TileReader = std::function<lapis::Raster<T>(const std::filesystem::path&, const std::optional<lapis::Extent>&)>;
+
+	//The grid of a mosaic over projE, taken from the header of one tile and extended and cropped to projE
+	//nullopt if the header can't be read
+	inline std::optional<lapis::Alignment> mosaicAlignment(const lapis::Extent& projE, const lapis::CoordRef& crs, const std::filesystem::path& file) {
+		try {
+			lapis::Alignment a{ file.string() };
+			a.defineCRS(crs);
+			a = extendAlignment(a, projE, lapis::SnapType::out);
+			return cropAlignment(a, projE, lapis::SnapType::out);
+		}
+		catch (lapis::LapisGisException e) {
+			return std::nullopt;
+		}
+	}
+
+	//The shared core of the fineDataByExtentGeneric functions
+	//Tiles are decoded in parallel, but overlaid in the order given, so the output is the same as reading them one at a time
+	//The output alignment is taken from the first tile whose header can be read, and tiles before that one are skipped
+	//If cache isn't null, whole tiles are read and kept in it under the given product name, instead of just the part inside projE
+	//If reader is null, tiles are read directly as Raster<T>
+	template<class T>
+	std::optional<lapis::Raster<T>> mosaicTiles(const lapis::Extent& projE, const lapis::CoordRef& crs, const std::vector<size_t>& tiles,
+		const std::function<std::optional<std::filesystem::path>(size_t)>& byTile,
+		const std::function<void(lapis::Raster<T>&, const lapis::Raster<T>&)>& overlay,
+		TileCache* cache, const std::string& product, const TileReader<T>& reader = nullptr) {
+
+		//path lookups can create files in some folder types, so they stay on this thread
+		std::vector<std::filesystem::path> paths;
+		std::vector<size_t> pathTiles;
+		for (size_t tile : tiles) {
+			std::optional<std::filesystem::path> filePath = byTile(tile);
+			if (filePath) {
+				paths.push_back(filePath.value());
+				pathTiles.push_back(tile);
+			}
+		}
+
+		std::optional<lapis::Raster<T>> out{};
+		size_t first = 0;
+		for (; first < paths.size(); ++first) {
+			std::optional<lapis::Alignment> a = mosaicAlignment(projE, crs, paths[first]);
+			if (a) {
+				out = lapis::Raster<T>{ a.value() };
+				break;
+			}
+		}
+		if (!out.has_value()) {
+			return out;
+		}
+
+		auto decode = [&](const std::filesystem::path& filePath, const std::optional<lapis::Extent>& e) {
+			if (reader) {
+				return std::make_shared<lapis::Raster<T>>(reader(filePath, e));
+			}
+			if (e) {
+				return std::make_shared<lapis::Raster<T>>(filePath.string(), e.value(), lapis::SnapType::out);
+			}
+			return std::make_shared<lapis::Raster<T>>(filePath.string());
+			};
+
+		using TilePtr = std::shared_ptr<const lapis::Raster<T>>;
+		std::function<TilePtr(size_t)> read = [&](size_t i)->TilePtr {
+			const std::filesystem::path& filePath = paths[first + i];
+			try {
+				if (!cache) {
+					auto tile = decode(filePath, projE);
+					tile->defineCRS(crs);
+					return tile;
+				}
+				TilePtr cached = cache->get<T>(product, pathTiles[first + i]);
+				if (cached) {
+					return cached;
+				}
+				auto tile = decode(filePath, std::nullopt);
+				tile->defineCRS(crs);
+				cache->put<T>(product, pathTiles[first + i], tile);
+				return tile;
+			}
+			catch (lapis::LapisGisException e) {
+				return nullptr;
+			}
+			};
+		std::function<void(size_t, TilePtr&)> apply = [&](size_t, TilePtr& tile) {
+			if (tile && tile->overlaps(out.value())) {
+				overlay(out.value(), *tile);
+			}
+			};
+		orderedParallelFor(paths.size() - first, read, apply);
+		return out;
+	}
+}
+
+#endif
@@ -0,0 +1,23 @@
+#include "TilePipeline.hpp"
+
+#if defined(__linux__)
+#include<fcntl.h>
+#include<unistd.h>
+#endif
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	void adviseWillNeed(const fs::path& file)
+	{
+#if defined(__linux__)
+		int fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return;
+		}
+		//the page cache keeps what's read in after the file is closed
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		close(fd);
+#endif
+	}
+}
@@ -0,0 +1,170 @@
+#pragma once
+#ifndef TILEPIPELINE_H
+#define TILEPIPELINE_H
+
+#include "ProcessedFolder_pch.hpp"
+#include "Parallel.hpp"
+
+namespace processedfolder {
+	struct TilePipelineOptions {
+		//threads running the callback. 0 means availableThreads()
+		int nWorker = 0;
+		//threads decoding tiles ahead of the workers
+		int nDecoder = 2;
+		//decoded tiles waiting for a worker, on top of the ones being decoded and worked on. 0 means nWorker
+		size_t maxInFlight = 0;
+		//how many files ahead of the decoders the OS is asked to start reading
+		size_t adviseAhead = 8;
+	};
+
+	//Tells the OS the whole file will be read soon, so it can start pulling it into the page cache
+	//Only does anything where posix_fadvise is available; failures are ignored
+	void adviseWillNeed(const std::filesystem::path& file);
+
+	//A queue for handing work between threads. push waits while it's full, and pop waits while it's empty
+	//After close, pop drains what's left and then returns nullopt. After abort, both return straight away
+	template<class T>
+	class BoundedQueue {
+	public:
+		BoundedQueue(size_t capacity) : _capacity(std::max<size_t>(capacity, 1)) {}
+
+		//false if the queue was aborted
+		bool push(T item) {
+			std::unique_lock lock{ _mut };
+			_notFull.wait(lock, [&] { return _aborted || _items.size() < _capacity; });
+			if (_aborted) {
+				return false;
+			}
+			_items.push_back(std::move(item));
+			_notEmpty.notify_one();
+			return true;
+		}
+		std::optional<T> pop() {
+			std::unique_lock lock{ _mut };
+			_notEmpty.wait(lock, [&] { return _aborted || _closed || _items.size(); });
+			if (_aborted || !_items.size()) {
+				return std::nullopt;
+			}
+			T out = std::move(_items.front());
+			_items.pop_front();
+			_notFull.notify_one();
+			return out;
+		}
+		void close() {
+			std::lock_guard lock{ _mut };
+			_closed = true;
+			_notEmpty.notify_all();
+		}
+		void abort() {
+			std::lock_guard lock{ _mut };
+			_aborted = true;
+			_notEmpty.notify_all();
+			_notFull.notify_all();
+		}
+
+	private:
+		std::mutex _mut;
+		std::condition_variable _notFull;
+		std::condition_variable _notEmpty;
+		std::deque<T> _items;
+		size_t _capacity;
+		bool _closed = false;
+		bool _aborted = false;
+	};
+
+	//Calls fn(tile, raster) for every tile in [0,nTile) that byTile finds a readable file for, with crs defined on each raster
+	//File paths are looked up in tile order on the calling thread, the files are decoded on nDecoder threads, and fn runs on nWorker threads,
+	//so reading the next tiles overlaps work on the current ones. fn may be called for tiles out of order, and from several threads at once
+	//Tiles that can't be decoded are skipped. Any other exception, from byTile, decoding, or fn, stops the pipeline and the first one is rethrown once every thread has finished
+	template<class T>
+	void forEachTileFile(size_t nTile, const lapis::CoordRef& crs, const std::function<std::optional<std::filesystem::path>(size_t)>& byTile,
+		const std::function<void(size_t, const lapis::Raster<T>&)>& fn, const TilePipelineOptions& options = TilePipelineOptions()) {
+		int nWorker = options.nWorker > 0 ? options.nWorker : availableThreads();
+		int nDecoder = std::max(options.nDecoder, 1);
+		size_t maxInFlight = options.maxInFlight ? options.maxInFlight : (size_t)nWorker;
+
+		using Decoded = std::pair<size_t, std::shared_ptr<const lapis::Raster<T>>>;
+		BoundedQueue<std::pair<size_t, std::filesystem::path>> files{ std::max<size_t>(options.adviseAhead, 1) };
+		BoundedQueue<Decoded> decoded{ maxInFlight };
+
+		std::mutex errorMut;
+		std::exception_ptr error;
+		auto fail = [&] {
+			std::lock_guard lock{ errorMut };
+			if (!error) {
+				error = std::current_exception();
+			}
+			files.abort();
+			decoded.abort();
+			};
+
+		std::vector<std::thread> decoders;
+		for (int t = 0; t < nDecoder; ++t) {
+			decoders.emplace_back([&] {
+				WorkerThreadScope scope;
+				while (std::optional<std::pair<size_t, std::filesystem::path>> file = files.pop()) {
+					std::shared_ptr<lapis::Raster<T>> tile;
+					try {
+						tile = std::make_shared<lapis::Raster<T>>(file->second.string());
+						tile->defineCRS(crs);
+					}
+					catch (lapis::LapisGisException e) {
+						continue;
+					}
+					catch (...) {
+						fail();
+						return;
+					}
+					if (!decoded.push({ file->first, std::move(tile) })) {
+						return;
+					}
+				}
+				});
+		}
+		std::vector<std::thread> workers;
+		for (int t = 0; t < nWorker; ++t) {
+			workers.emplace_back([&] {
+				WorkerThreadScope scope;
+				while (std::optional<Decoded> tile = decoded.pop()) {
+					try {
+						fn(tile->first, *tile->second);
+					}
+					catch (...) {
+						fail();
+						return;
+					}
+				}
+				});
+		}
+
+		//the files queue is as deep as the advice reaches, so a file is advised about when it joins the queue
+		try {
+			for (size_t i = 0; i < nTile; ++i) {
+				std::optional<std::filesystem::path> file = byTile(i);
+				if (!file) {
+					continue;
+				}
+				adviseWillNeed(file.value());
+				if (!files.push({ i, file.value() })) {
+					break;
+				}
+			}
+		}
+		catch (...) {
+			fail();
+		}
+		files.close();
+		for (std::thread& t : decoders) {
+			t.join();
+		}
+		decoded.close();
+		for (std::thread& t : workers) {
+			t.join();
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "TopoScaleTable.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	TopoScaleTable::TopoScaleTable(Lister lister, ScaleParser parser) : _lister(lister), _parser(parser)
+	{
+	}
+
+	std::optional<fs::path> TopoScaleTable::nearest(lapis::coord_t scale, lapis::coord_t tolerance) const
+	{
+		std::lock_guard lock{ _mut };
+		const auto& table = _getTable();
+
+		auto after = std::lower_bound(table.begin(), table.end(), scale, [](const auto& entry, lapis::coord_t s) { return entry.first < s; });
+		auto best = table.end();
+		if (after != table.end()) {
+			best = after;
+		}
+		if (after != table.begin()) {
+			auto before = std::prev(after);
+			if (best == table.end() || scale - before->first <= best->first - scale) {
+				best = before;
+			}
+		}
+		if (best == table.end() || std::abs(best->first - scale) > tolerance) {
+			return std::nullopt;
+		}
+		return best->second;
+	}
+
+	std::vector<lapis::coord_t> TopoScaleTable::scales() const
+	{
+		std::lock_guard lock{ _mut };
+		std::vector<lapis::coord_t> out;
+		for (const auto& entry : _getTable()) {
+			out.push_back(entry.first);
+		}
+		return out;
+	}
+
+	void TopoScaleTable::refresh()
+	{
+		std::lock_guard lock{ _mut };
+		_table.reset();
+	}
+
+	const std::vector<std::pair<lapis::coord_t, fs::path>>& TopoScaleTable::_getTable() const
+	{
+		if (!_table) {
+			_table.emplace();
+			for (const fs::path& file : _lister()) {
+				std::optional<lapis::coord_t> scale = _parser(file.filename().string());
+				if (scale) {
+					_table->emplace_back(scale.value(), file);
+				}
+			}
+			std::stable_sort(_table->begin(), _table->end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		}
+		return _table.value();
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef TOPOSCALETABLE_H
+#define TOPOSCALETABLE_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//The files of one topographic product, sorted by the scale encoded in their names
+	//The directory is read and the names parsed the first time a lookup is made, and not again until refresh()
+	class TopoScaleTable {
+	public:
+		using Lister = std::function<std::vector<std::filesystem::path>()>;
+		//returns the scale encoded in the file name, or nullopt if the file isn't part of this product
+		using ScaleParser = std::function<std::optional<lapis::coord_t>(const std::string& fileName)>;
+
+		TopoScaleTable(Lister lister, ScaleParser parser);
+
+		//the file whose scale is closest to the given one, if it's within tolerance of it
+		std::optional<std::filesystem::path> nearest(lapis::coord_t scale, lapis::coord_t tolerance) const;
+
+		std::vector<lapis::coord_t> scales() const;
+
+		void refresh();
+
+	private:
+		Lister _lister;
+		ScaleParser _parser;
+
+		mutable std::mutex _mut;
+		mutable std::optional<std::vector<std::pair<lapis::coord_t, std::filesystem::path>>> _table;
+
+		const std::vector<std::pair<lapis::coord_t, std::filesystem::path>>& _getTable() const;
+	};
+}
+
+#endif
@@ -0,0 +1,223 @@
+#pragma once
+#ifndef VIRTUALMOSAIC_H
+#define VIRTUALMOSAIC_H
+
+#include "ProcessedFolder_pch.hpp"
+#include "TileMosaic.hpp"
+
+namespace processedfolder {
+	//A read-only view of a tile mosaic that only decodes the parts that are looked at
+	//The grid is split into square blocks of cells, and each block is read from the tiles under it the first time one of its cells is asked for
+	//The most recently used blocks are kept, up to maxBlocks, so memory follows the working set rather than the extent
+	//Where tiles overlap, the first one in tile order wins, as in mosaicTiles
+	//Tiles are chosen for a block by their layout extents, so a tile whose buffer reaches into a block it doesn't otherwise overlap isn't read for that block
+	//This is safe to use from several threads at once
+	template<class T>
+	class VirtualMosaic : public lapis::Alignment {
+	public:
+		struct Tile {
+			size_t index;
+			lapis::Extent extent;
+		};
+
+		//byTile is only called for tiles that are needed, and never from two threads at once
+		//It's kept for as long as the mosaic is, so whatever it refers to must outlive the mosaic
+		VirtualMosaic(const lapis::Alignment& a, std::vector<Tile> tiles, const std::function<std::optional<std::filesystem::path>(size_t)>& byTile,
+			const std::function<void(lapis::Raster<T>&, const lapis::Raster<T>&)>& overlay,
+			size_t maxBlocks = 64, lapis::rowcol_t blockSize = 256, const TileReader<T>& reader = nullptr)
+			: lapis::Alignment(a), _tiles(std::move(tiles)), _byTile(byTile), _overlay(overlay), _reader(reader),
+			_maxBlocks(std::max<size_t>(maxBlocks, 1)), _blockSize(std::max<lapis::rowcol_t>(blockSize, 1)) {
+			_blockCols = (ncol() + _blockSize - 1) / _blockSize;
+		}
+
+		std::optional<T> atCell(lapis::cell_t cell) const {
+			if (cell < 0 || cell >= ncell()) {
+				return std::nullopt;
+			}
+			return atRC(cell / ncol(), cell % ncol());
+		}
+		std::optional<T> operator[](lapis::cell_t cell) const {
+			return atCell(cell);
+		}
+		std::optional<T> atRC(lapis::rowcol_t row, lapis::rowcol_t col) const {
+			if (row < 0 || row >= nrow() || col < 0 || col >= ncol()) {
+				return std::nullopt;
+			}
+			std::shared_ptr<const lapis::Raster<T>> block = _block((size_t)(row / _blockSize) * _blockCols + col / _blockSize);
+			lapis::cell_t inBlock = block->cellFromRowColUnsafe(row % _blockSize, col % _blockSize);
+			if (!block->atCellUnsafe(inBlock).has_value()) {
+				return std::nullopt;
+			}
+			return block->atCellUnsafe(inBlock).value();
+		}
+		std::optional<T> atXY(lapis::coord_t x, lapis::coord_t y) const {
+			if (!contains(x, y)) {
+				return std::nullopt;
+			}
+			return atCell(cellFromXYUnsafe(x, y));
+		}
+
+		//Copies the part of the mosaic inside e into an ordinary raster
+		//This goes one block at a time, so the cache is only consulted once per block rather than once per cell
+		lapis::Raster<T> window(const lapis::Extent& e) const {
+			lapis::Raster<T> out{ cropAlignment(*this, e, lapis::SnapType::out) };
+			lapis::rowcol_t rowOffset = (lapis::rowcol_t)std::llround((ymax() - out.ymax()) / yres());
+			lapis::rowcol_t colOffset = (lapis::rowcol_t)std::llround((out.xmin() - xmin()) / xres());
+			lapis::rowcol_t firstRow = std::max<lapis::rowcol_t>(rowOffset, 0);
+			lapis::rowcol_t endRow = std::min<lapis::rowcol_t>(rowOffset + out.nrow(), nrow());
+			lapis::rowcol_t firstCol = std::max<lapis::rowcol_t>(colOffset, 0);
+			lapis::rowcol_t endCol = std::min<lapis::rowcol_t>(colOffset + out.ncol(), ncol());
+
+			for (lapis::rowcol_t blockRow = firstRow / _blockSize; blockRow * _blockSize < endRow; ++blockRow) {
+				for (lapis::rowcol_t blockCol = firstCol / _blockSize; blockCol * _blockSize < endCol; ++blockCol) {
+					BlockPtr block = _block((size_t)blockRow * _blockCols + blockCol);
+					lapis::rowcol_t rowStart = std::max(firstRow, blockRow * _blockSize);
+					lapis::rowcol_t rowEnd = std::min(endRow, (blockRow + 1) * _blockSize);
+					lapis::rowcol_t colStart = std::max(firstCol, blockCol * _blockSize);
+					lapis::rowcol_t colEnd = std::min(endCol, (blockCol + 1) * _blockSize);
+					for (lapis::rowcol_t row = rowStart; row < rowEnd; ++row) {
+						for (lapis::rowcol_t col = colStart; col < colEnd; ++col) {
+							lapis::cell_t from = block->cellFromRowColUnsafe(row - blockRow * _blockSize, col - blockCol * _blockSize);
+							if (!block->atCellUnsafe(from).has_value()) {
+								continue;
+							}
+							lapis::cell_t to = out.cellFromRowColUnsafe(row - rowOffset, col - colOffset);
+							out[to].has_value() = true;
+							out[to].value() = block->atCellUnsafe(from).value();
+						}
+					}
+				}
+			}
+			return out;
+		}
+
+		size_t blocksLoaded() const {
+			std::lock_guard lock{ *_mut };
+			return _loads;
+		}
+
+	private:
+		using BlockPtr = std::shared_ptr<const lapis::Raster<T>>;
+
+		std::vector<Tile> _tiles;
+		std::function<std::optional<std::filesystem::path>(size_t)> _byTile;
+		std::function<void(lapis::Raster<T>&, const lapis::Raster<T>&)> _overlay;
+		TileReader<T> _reader;
+		size_t _maxBlocks;
+		lapis::rowcol_t _blockSize;
+		lapis::rowcol_t _blockCols = 0;
+
+		std::unique_ptr<std::mutex> _mut = std::make_unique<std::mutex>();
+		//separate, since finding a path can mean deriving the file
+		std::unique_ptr<std::mutex> _pathMut = std::make_unique<std::mutex>();
+		mutable std::list<std::pair<size_t, BlockPtr>> _lru; //most recently used at the front
+		mutable std::unordered_map<size_t, typename std::list<std::pair<size_t, BlockPtr>>::iterator> _lookup;
+		mutable std::unordered_map<size_t, std::optional<std::filesystem::path>> _paths;
+		mutable size_t _loads = 0;
+
+		BlockPtr _block(size_t block) const {
+			{
+				std::lock_guard lock{ *_mut };
+				auto found = _lookup.find(block);
+				if (found != _lookup.end()) {
+					_lru.splice(_lru.begin(), _lru, found->second);
+					return found->second->second;
+				}
+			}
+
+			//decoded without the lock, so a slow block doesn't hold up cells in blocks that are already loaded
+			BlockPtr loaded = _load(block);
+
+			std::lock_guard lock{ *_mut };
+			auto found = _lookup.find(block);
+			if (found != _lookup.end()) {
+				return found->second->second;
+			}
+			++_loads;
+			_lru.emplace_front(block, loaded);
+			_lookup[block] = _lru.begin();
+			while (_lru.size() > _maxBlocks) {
+				_lookup.erase(_lru.back().first);
+				_lru.pop_back();
+			}
+			return loaded;
+		}
+
+		std::optional<std::filesystem::path> _path(size_t tile) const {
+			std::lock_guard lock{ *_pathMut };
+			auto found = _paths.find(tile);
+			if (found != _paths.end()) {
+				return found->second;
+			}
+			//cells are usually read from several threads at once, so a tile derived here is derived on this thread alone
+			WorkerThreadScope scope;
+			std::optional<std::filesystem::path> out = _byTile(tile);
+			_paths[tile] = out;
+			return out;
+		}
+
+		BlockPtr _load(size_t block) const {
+			lapis::rowcol_t firstRow = (lapis::rowcol_t)(block / _blockCols) * _blockSize;
+			lapis::rowcol_t firstCol = (lapis::rowcol_t)(block % _blockCols) * _blockSize;
+			lapis::rowcol_t endRow = std::min(firstRow + _blockSize, nrow());
+			lapis::rowcol_t endCol = std::min(firstCol + _blockSize, ncol());
+			lapis::Extent blockExtent(xmin() + firstCol * xres(), xmin() + endCol * xres(), ymax() - endRow * yres(), ymax() - firstRow * yres());
+
+			auto out = std::make_shared<lapis::Raster<T>>(cropAlignment(*this, blockExtent, lapis::SnapType::near));
+			for (const Tile& tile : _tiles) {
+				if (!tile.extent.overlaps(blockExtent)) {
+					continue;
+				}
+				std::optional<std::filesystem::path> file = _path(tile.index);
+				if (!file) {
+					continue;
+				}
+				try {
+					lapis::Raster<T> data = _reader ? _reader(file.value(), blockExtent)
+						: lapis::Raster<T>{ file.value().string(), blockExtent, lapis::SnapType::out };
+					data.defineCRS(crs());
+					if (data.overlaps(*out)) {
+						_overlay(*out, data);
+					}
+				}
+				catch (lapis::LapisGisException e) {
+					continue;
+				}
+			}
+			return out;
+		}
+	};
+
+	//Opens a VirtualMosaic over projE with the same tiles, grid, and overlap rule as mosaicTiles would use
+	//The grid comes from the first of the tiles whose header can be read, so that tile's path is looked up here, on the calling thread
+	//extentOf gives the layout extent of each tile. nullopt if none of the tiles can be read
+	template<class T>
+	std::optional<VirtualMosaic<T>> openVirtualMosaic(const lapis::Extent& projE, const lapis::CoordRef& crs, const std::vector<size_t>& tiles,
+		const std::function<std::optional<lapis::Extent>(size_t)>& extentOf, const std::function<std::optional<std::filesystem::path>(size_t)>& byTile,
+		const std::function<void(lapis::Raster<T>&, const lapis::Raster<T>&)>& overlay, size_t maxBlocks) {
+		std::optional<lapis::Alignment> a;
+		for (size_t tile : tiles) {
+			std::optional<std::filesystem::path> file = byTile(tile);
+			if (file) {
+				a = mosaicAlignment(projE, crs, file.value());
+				if (a) {
+					break;
+				}
+			}
+		}
+		if (!a) {
+			return std::nullopt;
+		}
+
+		std::vector<typename VirtualMosaic<T>::Tile> withExtents;
+		for (size_t tile : tiles) {
+			std::optional<lapis::Extent> tileExtent = extentOf(tile);
+			if (tileExtent) {
+				withExtents.push_back({ tile, tileExtent.value() });
+			}
+		}
+		return VirtualMosaic<T>(a.value(), std::move(withExtents), byTile, overlay, maxBlocks);
+	}
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "VrtExport.hpp"
+#include "RasterRepair.hpp"
+
+namespace processedfolder {
+	namespace fs = std::filesystem;
+
+	struct VrtSource {
+		fs::path file;
+		lapis::Alignment alignment;
+		std::optional<double> noData;
+	};
+
+	static std::string escapeXml(const std::string& s) {
+		std::string out;
+		for (char c : s) {
+			switch (c) {
+			case '&': out += "&amp;"; break;
+			case '<': out += "&lt;"; break;
+			case '>': out += "&gt;"; break;
+			case '"': out += "&quot;"; break;
+			default: out += c;
+			}
+		}
+		return out;
+	}
+
+	bool writeTileVrt(const fs::path& vrt, const lapis::CoordRef& crs, const std::vector<fs::path>& tiles, const std::optional<lapis::Alignment>& grid,
+		TilePrecedence precedence)
+	{
+		std::optional<lapis::Alignment> expected = grid;
+		std::vector<VrtSource> sources;
+		GDALDataType dataType = GDT_Unknown;
+		for (const fs::path& tile : tiles) {
+			GDALDataset* ds = (GDALDataset*)GDALOpen(tile.string().c_str(), GA_ReadOnly);
+			if (!ds) {
+				continue;
+			}
+			double gt[6];
+			bool ok = ds->GetRasterCount() > 0 && ds->GetGeoTransform(gt) == CE_None;
+			if (!ok) {
+				GDALClose(ds);
+				continue;
+			}
+			GDALRasterBand* band = ds->GetRasterBand(1);
+			int hasNoData = 0;
+			double noData = band->GetNoDataValue(&hasNoData);
+			if (!sources.size()) {
+				dataType = band->GetRasterDataType();
+			}
+			lapis::rowcol_t nrow = ds->GetRasterYSize();
+			lapis::rowcol_t ncol = ds->GetRasterXSize();
+			GDALClose(ds);
+
+			lapis::coord_t yres = std::abs(gt[5]);
+			lapis::Alignment a{ gt[0], gt[3] - nrow * yres, nrow, ncol, gt[1], yres, crs };
+			if (!expected) {
+				expected = a;
+			}
+			try {
+				a = repairAlignment(a, expected->xres(), expected->yres(), expected->xmin(), expected->ymin());
+			}
+			catch (lapis::LapisGisException e) {
+				if (sources.size() || !grid) {
+					continue;
+				}
+				//the first readable tile isn't anywhere near the given grid, so this product is on a grid of its own
+				expected = a;
+			}
+			sources.push_back({ fs::absolute(tile), a, hasNoData ? std::optional<double>(noData) : std::nullopt });
+		}
+		if (!sources.size()) {
+			return false;
+		}
+
+		lapis::coord_t xres = expected->xres(), yres = expected->yres();
+		const lapis::Alignment& first = sources.front().alignment;
+		lapis::coord_t xmin = first.xmin(), xmax = first.xmax(), ymin = first.ymin(), ymax = first.ymax();
+		for (const VrtSource& s : sources) {
+			xmin = std::min(xmin, s.alignment.xmin());
+			xmax = std::max(xmax, s.alignment.xmax());
+			ymin = std::min(ymin, s.alignment.ymin());
+			ymax = std::max(ymax, s.alignment.ymax());
+		}
+		long long ncol = std::llround((xmax - xmin) / xres);
+		long long nrow = std::llround((ymax - ymin) / yres);
+
+		std::ostringstream out;
+		out << std::setprecision(17);
+		out << "<VRTDataset rasterXSize=\"" << ncol << "\" rasterYSize=\"" << nrow << "\">\n";
+		out << "  <SRS dataAxisToSRSAxisMapping=\"1,2\">" << escapeXml(crs.getCompleteWKT()) << "</SRS>\n";
+		out << "  <GeoTransform>" << xmin << ", " << xres << ", 0, " << ymax << ", 0, " << -yres << "</GeoTransform>\n";
+		out << "  <VRTRasterBand dataType=\"" << GDALGetDataTypeName(dataType) << "\" band=\"1\">\n";
+		if (sources.front().noData) {
+			out << "    <NoDataValue>" << sources.front().noData.value() << "</NoDataValue>\n";
+		}
+		//GDAL draws later sources over earlier ones, so for the first tile to win they're written last tile first
+		if (precedence == TilePrecedence::firstWins) {
+			std::reverse(sources.begin(), sources.end());
+		}
+		for (auto it = sources.begin(); it != sources.end(); ++it) {
+			const lapis::Alignment& a = it->alignment;
+			out << "    <ComplexSource>\n";
+			out << "      <SourceFilename relativeToVRT=\"0\">" << escapeXml(it->file.string()) << "</SourceFilename>\n";
+			out << "      <SourceBand>1</SourceBand>\n";
+			out << "      <SrcRect xOff=\"0\" yOff=\"0\" xSize=\"" << a.ncol() << "\" ySize=\"" << a.nrow() << "\" />\n";
+			out << "      <DstRect xOff=\"" << std::llround((a.xmin() - xmin) / xres) << "\" yOff=\"" << std::llround((ymax - a.ymax()) / yres)
+				<< "\" xSize=\"" << a.ncol() << "\" ySize=\"" << a.nrow() << "\" />\n";
+			if (it->noData) {
+				out << "      <NODATA>" << it->noData.value() << "</NODATA>\n";
+			}
+			out << "    </ComplexSource>\n";
+		}
+		out << "  </VRTRasterBand>\n";
+		out << "</VRTDataset>\n";
+
+		std::ofstream file{ vrt };
+		if (!file) {
+			return false;
+		}
+		file << out.str();
+		return (bool)file;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#ifndef VRTEXPORT_H
+#define VRTEXPORT_H
+
+#include "ProcessedFolder_pch.hpp"
+
+namespace processedfolder {
+	//Which tile's value is kept where tiles overlap
+	enum class TilePrecedence {
+		firstWins,
+		lastWins
+	};
+
+	//Writes a GDAL VRT mosaicking the given tile files, so the whole run can be opened as one raster without copying any cells
+	//The VRT is in crs, whatever the tiles themselves claim. Each tile's resolution and origin are fixed by repairAlignment onto grid where they're slightly off
+	//If grid isn't given, or the first readable tile isn't within tolerance of it, the first readable tile's grid is used instead
+	//Tiles that can't be opened or repaired are left out
+	//Returns false if no tile could be read or the VRT couldn't be written
+	bool writeTileVrt(const std::filesystem::path& vrt, const lapis::CoordRef& crs, const std::vector<std::filesystem::path>& tiles,
+		const std::optional<lapis::Alignment>& grid, TilePrecedence precedence);
+}
+
+#endif